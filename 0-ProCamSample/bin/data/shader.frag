@@ -6,9 +6,14 @@ uniform int level;
 uniform int inverted;
 uniform int xcode;
 uniform int ycode;
+uniform int phase;
+uniform int phaseSteps;
+uniform int phasePeriod;
 
 out vec4 outputColor;
 
+const float TWO_PI = 6.2831853072;
+
 int grayCode(int x) {
     return (x >> 1) ^ x;
 }
@@ -21,6 +26,12 @@ void main() {
     int x = int(gl_FragCoord.x) + xcode;
     int y = int(height - gl_FragCoord.y) + ycode; // check this isn't off-by-one
     int src = (axis == 0) ? x : y;
+    if(phase >= 0) {
+        // sinusoid with pixel centers at x + .5, shifted by phase / phaseSteps of a period
+        float angle = TWO_PI * ((float(src) + .5) / float(phasePeriod) + float(phase) / float(phaseSteps));
+        outputColor = vec4(vec3(.5 + .5 * cos(angle)), 1);
+        return;
+    }
     src = grayCode(src);
     src = isTrue(src, level);
     src = inverted == 0 ? src : 1 - src;
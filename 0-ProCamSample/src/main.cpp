@@ -103,7 +103,8 @@ public:
     uint64_t lastCaptureTime = 0;
     string timestamp;
     int pattern = 0;
-    vector<tuple<int,int,int,int>> patterns;
+    vector<tuple<int,int,int,int,int>> patterns;
+    int phaseSteps = 0;
     NetworkCamera camera;
     ofxWebServer webserver;
     
@@ -114,30 +115,39 @@ public:
         webserver.addHandler(this, "actions/*");
         
     }
-    void config(ofVec2f box) {
+    void config(ofVec2f box, int phaseSteps) {
+        this->phaseSteps = phaseSteps;
         int xk = ceil(log2(box.x));
         int yk = ceil(log2(box.y));
         
-        int axis, level, inverted, levelCount;
+        int axis, level, inverted, levelCount, phase;
         axis = 0;
         for(level = 0; level < xk; level++) {
             for(int inverted : {0,1}) {
-                patterns.emplace_back(make_tuple(axis, level, inverted, xk));
+                patterns.emplace_back(make_tuple(axis, level, inverted, xk, -1));
             }
         }
         axis = 1;
         for(level = 0; level < yk; level++) {
             for(int inverted : {0,1}) {
-                patterns.emplace_back(make_tuple(axis, level, inverted, yk));
+                patterns.emplace_back(make_tuple(axis, level, inverted, yk, -1));
+            }
+        }
+        
+        // optional phase shifted sinusoids after the gray codes, for sub-pixel decoding
+        for(axis = 0; axis < 2; axis++) {
+            for(phase = 0; phase < phaseSteps; phase++) {
+                patterns.emplace_back(make_tuple(axis, 0, 0, 0, phase));
             }
         }
         
         cout << "Bounding box: " << box << endl;
         cout << "level count: " << xk << ", " << yk << endl;
+        cout << "phase steps: " << phaseSteps << endl;
         cout << "List of patterns:" << endl;
         for(auto cur : patterns) {
-            tie(axis, level, inverted, levelCount) = cur;
-            cout << "\t" << axis << ", " << level << ", " << inverted << ", " << levelCount << endl;
+            tie(axis, level, inverted, levelCount, phase) = cur;
+            cout << "\t" << axis << ", " << level << ", " << inverted << ", " << levelCount << ", " << phase << endl;
         }
     }
     bool nextState() {
@@ -169,10 +179,16 @@ public:
         if(capturing) {
             if(needToCapture && curTime > bufferTime + lastCaptureTime) {
                 string directory = "../../../SharedData/scan-" + timestamp + "/cameraImages/" +
-                (getAxis() == 0 ? "vertical/" : "horizontal/") +
-                (getInverted() == 0 ? "normal/" : "inverse/");
-                // we need to invert here to keep with an older style
-                string levelName = ofToString(getLevelCount() - getLevel() - 1);
+                (getAxis() == 0 ? "vertical/" : "horizontal/");
+                string levelName;
+                if(getPhase() < 0) {
+                    directory += getInverted() == 0 ? "normal/" : "inverse/";
+                    // we need to invert here to keep with an older style
+                    levelName = ofToString(getLevelCount() - getLevel() - 1);
+                } else {
+                    directory += "phase/";
+                    levelName = ofToString(getPhase());
+                }
                 camera.takePhoto(directory + levelName + ".jpg");
                 needToCapture = false;
             }
@@ -209,6 +225,13 @@ public:
     int getLevelCount() {
         return get<3>(patterns[pattern]);
     }
+    // -1 for gray code patterns, otherwise the step of the phase shifted sinusoid
+    int getPhase() {
+        return get<4>(patterns[pattern]);
+    }
+    int getPhaseSteps() {
+        return phaseSteps;
+    }
     
     void start(){
         pattern = 0;
@@ -252,6 +275,7 @@ void loadImage(string fn, ofImage_<T>& img) {
 class ClientApp : public ofBaseApp {
 public:
     int id, xcode, ycode;
+    int phasePeriod;
     float hue;
     shared_ptr<ServerApp> server;
     
@@ -264,6 +288,7 @@ public:
         this->xcode = xcode;
         this->ycode = ycode;
         this->server = server;
+        phasePeriod = jsonconfig["sample"]["phasePeriod"];
         loadImage("../../../SharedData/mask-" + ofToString(id) + ".png", mask);
     }
     void setup() {
@@ -281,6 +306,9 @@ public:
         shader.setUniform1i("axis", server->getAxis());
         shader.setUniform1i("level", server->getLevel());
         shader.setUniform1i("inverted", server->getInverted());
+        shader.setUniform1i("phase", server->getPhase());
+        shader.setUniform1i("phaseSteps", server->getPhaseSteps());
+        shader.setUniform1i("phasePeriod", phasePeriod);
         shader.setUniform1i("xcode", xcode);
         shader.setUniform1i("ycode", ycode);
         ofDrawRectangle(0, 0, ofGetWidth(), ofGetHeight());
@@ -324,7 +352,8 @@ int main() {
     shared_ptr<ServerApp> appServer(new ServerApp);
     
     ofVec2f box = getBoundingBox(jsonconfig["projectors"]);
-    appServer->config(box);
+    int phaseSteps = jsonconfig["sample"]["phaseSteps"];
+    appServer->config(box, phaseSteps);
     ofRunApp(winServer, appServer);
     
     ofGLFWWindowSettings settings;
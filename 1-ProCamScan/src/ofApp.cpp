@@ -1,6 +1,7 @@
 #include "ofApp.h"
 
 #include "LightLeaksUtilities.h"
+#include "CalibrationMetrics.h"
 
 using namespace ofxCv;
 using namespace cv;
@@ -10,6 +11,9 @@ using namespace cv;
 #define FINETUNE_TRANSLATION
 //#define USE_LCP
 
+// Rasterize the camera pixels as a mesh in projector space instead of splatting them with buildProMapDist
+#define USE_PROMAP_MESH
+
 // Situations like capturing a lcd screen, highpass should be disabled since it blurs the image
 #define RUN_HIGHPASS
 
@@ -20,53 +24,10 @@ int highpassBlurSize = 300;
 
 int calibrationMode = INTER_CUBIC;
 
-bool natural(const ofFile& a, const ofFile& b) {
-	string aname = a.getBaseName(), bname = b.getBaseName();
-	int aint = ofToInt(aname), bint = ofToInt(bname);
-	if(ofToString(aint) == aname && ofToString(bint) == bname) {
-		return aint < bint;
-	} else {
-		return a < b;
-	}
-}
-
-void processGraycodeLevel(int i, int n, int dimensions, Mat& confidence, Mat& binaryCoded, Mat& minMat, Mat& maxMat, ofImage * imageNormal, ofImage * imageInverse) {
-    ofLogVerbose() << "Process " << i << " of " << n;
-    
-	int w = imageNormal->getWidth(), h = imageNormal->getHeight();
-	cv::Mat imageNormalGray, imageInverseGray;
-    imageNormalGray = toCv(*imageNormal);
-    imageInverseGray = toCv(*imageInverse);
-    
-    
-	if(i == 0) {
-		minMat = min(imageNormalGray, imageInverseGray);
-		maxMat = max(imageNormalGray, imageInverseGray);
-	} else {
-		min(minMat, imageNormalGray, minMat);
-		min(minMat, imageInverseGray, minMat);
-		max(maxMat, imageNormalGray, maxMat);
-		max(maxMat, imageInverseGray, maxMat);
-	}
-    
-    unsigned short curMask = 1 << (n - i - 1);
-	for(int y = 0; y < h; y++) {
-		for(int x = 0; x < w; x++) {
-			const unsigned char& normal = imageNormalGray.at<unsigned char>(y, x);
-			const unsigned char& inverse = imageInverseGray.at<unsigned char>(y, x);
-			if(normal > inverse) {
-				binaryCoded.at<unsigned short>(y, x) |= curMask;
-			}
-			float range = fabsf((float) normal - (float) inverse);
-            confidence.at<float>(y, x) += range;
-		}
-    }
-    
-//    saveImage(imageNormalGray, "normal-gray-" + ofToString(i) + ".jpg");
-//    saveImage(imageInverseGray, "inverse-gray-" + ofToString(i) + ".jpg");
-//    saveImage(confidence, "confidence-" + ofToString(i) + ".exr");
-//    cout << "cur variation: " << curVariation << endl;
-}
+// mesh triangles need this much confidence at every corner, and no edge longer
+// than this many projector pixels (anything longer is a discontinuity)
+float meshMinConfidence = .05;
+float meshMaxEdge = 4;
 
 // allocates two 32f Mats each time
 void highpass(Mat img) {
@@ -137,6 +98,65 @@ cv::Rect findCalibrationTranslation(Mat baseImage, Mat image, int size, string n
     return bestR;
 }
 
+// loads the optional phase shifted captures in order, empty if there are none.
+// no highpass on the images themselves, the phase decode already ignores ambient
+// light, but the shift against the reference is found on a highpassed copy like
+// the gray codes so every phase sample lines up with its gray code pixel.
+vector<Mat> ofApp::loadPhaseImages(string path, const Mat cameraMask, Mat referenceImage, string name) {
+    vector<Mat> images;
+    ofDirectory dir(path);
+    if(!dir.exists()) {
+        return images;
+    }
+    dir.allowExt("jpg");
+    dir.listDir();
+    vector<ofFile> files = dir.getFiles();
+    ofSort(files, natural);
+    for(int i = 0; i < files.size(); i++) {
+        ofImage image;
+        image.setUseTexture(false);
+        image.load(files[i].path());
+        image.setImageType(OF_IMAGE_GRAYSCALE);
+        Mat mat = toCv(image).clone();
+        if(cameraMask.cols > 0){
+            mat &= cameraMask;
+        }
+        Mat match = mat.clone();
+        highpass(match);
+        if(cameraMask.cols > 0){
+            match &= cameraMask;
+        }
+        alignImage(mat, match, referenceImage, name+"_"+ofToString(i));
+        images.push_back(mat);
+    }
+    return images;
+}
+
+// the undistort and the shift against the reference image that every capture
+// gets. the shift is found on match and applied to image, they can be the same
+void ofApp::alignImage(Mat image, Mat match, Mat referenceImage, string name){
+#ifdef USE_LCP
+    Mat bufferMat;
+    copy(image, bufferMat);
+    calibration.undistort(bufferMat, image, calibrationMode);
+    if(match.data != image.data) {
+        copy(match, bufferMat);
+        calibration.undistort(bufferMat, match, calibrationMode);
+    }
+#endif
+    
+#ifdef FINETUNE_TRANSLATION
+    // Number of pixels to search in each direcrtion on y axis for best match:
+    int searchArea = 7;
+    
+    auto r = findCalibrationTranslation(referenceImage, match, searchArea, name);
+    Mat trans_mat =(Mat_<double>(2,3) << 1, 0, r.x, 0, 1, -(r.y-searchArea));
+    
+    // Transform the image with the new roi
+    cv::warpAffine(image, image, trans_mat, image.size());
+#endif
+}
+
 void ofApp::processImageSet(ofFile fileNormal, ofFile fileInverse, ofImage *& imageNormal, ofImage *& imageInverse, const Mat cameraMask, Mat referenceImage, string name){
     //Load images
     imageNormal = new ofImage();
@@ -170,34 +190,8 @@ void ofApp::processImageSet(ofFile fileNormal, ofFile fileInverse, ofImage *& im
         matInverse &= cameraMask;
     }
 
-#ifdef USE_LCP
-    Mat bufferMat;
-    copy(matNormal, bufferMat);
-    calibration.undistort(bufferMat, matNormal, calibrationMode);
-
-    copy(matInverse, bufferMat);
-    calibration.undistort(bufferMat, matInverse, calibrationMode);
-    
-//    calibration.undistort(matNormal, calibrationMode);
-//    calibration.undistort(matInverse, calibrationMode);
-
-#endif
-    
-    
-#ifdef FINETUNE_TRANSLATION
-    // Number of pixels to search in each direcrtion on y axis for best match:
-    int searchArea = 7;
-    
-    auto r1 = findCalibrationTranslation(referenceImage, matNormal, searchArea, name+"_normal");
-    auto r2 = findCalibrationTranslation(referenceImage, matInverse, searchArea, name+"_inverse");
-    
-    Mat trans_mat_normal =(Mat_<double>(2,3) << 1, 0, r1.x, 0, 1, -(r1.y-searchArea));
-    Mat trans_mat_inverse =(Mat_<double>(2,3) << 1, 0, r2.x, 0, 1, -(r2.y-searchArea));
-    
-    // Transform the image with the new roi
-    cv::warpAffine(matNormal, matNormal, trans_mat_normal, matNormal.size());
-    cv::warpAffine(matInverse, matInverse, trans_mat_inverse, matInverse.size());
-#endif
+    alignImage(matNormal, matNormal, referenceImage, name+"_normal");
+    alignImage(matInverse, matInverse, referenceImage, name+"_inverse");
 }
 
 void ofApp::setup() {
@@ -448,6 +442,26 @@ void ofApp::setup() {
             
             
             ofJson settings = ofLoadJson("settings.json");
+            
+            // phase shifted sinusoids captured after the gray codes refine the
+            // integer projector coordinates to sub-pixel precision
+            vector<Mat> phaseVertical = loadPhaseImages(path + "cameraImages/vertical/phase/", cameraMaskMat, baseMat, "pv");
+            vector<Mat> phaseHorizontal = loadPhaseImages(path + "cameraImages/horizontal/phase/", cameraMaskMat, baseMat, "ph");
+            Mat refinedVertical, refinedHorizontal;
+            bool usePhase = !phaseVertical.empty() && !phaseHorizontal.empty();
+            if(usePhase) {
+                int phasePeriod = settings["sample"]["phasePeriod"];
+                float phaseMinModulation = settings["sample"]["phaseMinModulation"];
+                ofLogVerbose() << "refining with " << phaseVertical.size() << " phase steps, period " << phasePeriod;
+                Mat modulationVertical, modulationHorizontal;
+                phaseRefine(phaseVertical, binaryCodedVertical, phasePeriod, phaseMinModulation, refinedVertical, modulationVertical);
+                phaseRefine(phaseHorizontal, binaryCodedHorizontal, phasePeriod, phaseMinModulation, refinedHorizontal, modulationHorizontal);
+#ifdef SAVE_DEBUG
+                Mat modulation = modulationVertical + modulationHorizontal;
+                saveImage(modulation, path+"/phaseModulation.exr");
+#endif
+            }
+            
                 int width=0, height=0;
                 for(auto p : settings["projectors"]){
                     width = MAX(width, int(p["width"]) + int(p["xcode"]));
@@ -466,19 +480,64 @@ void ofApp::setup() {
 //                        proMap);
                 
                 
+#ifdef USE_PROMAP_MESH
+            Mat coordX, coordY, proMapFine;
+            if(usePhase) {
+                coordX = refinedVertical;
+                coordY = refinedHorizontal;
+            } else {
+                binaryCodedVertical.convertTo(coordX, CV_32F);
+                binaryCodedHorizontal.convertTo(coordY, CV_32F);
+            }
+            buildProMapMesh(width, height,
+                            coordX, coordY,
+                            camConfidence,
+                            meshMinConfidence, meshMaxEdge,
+                            proConfidence,
+                            proMap,
+                            proMapFine);
+#else
                 buildProMapDist(width, height,
                         binaryCoded,
                         camConfidence,
                         proConfidence,
                         proMap,
                         3);
+#endif
 
             if(!projectorMaskMat.empty()) {
+                // the masks are rebuilt from this, building them from masked
+                // confidence would pull them in further every time
+                saveImage(proConfidence, path+"/proConfidenceUnmasked.exr");
                 cv::multiply(projectorMaskMat, proConfidence, proConfidence);
             }
 
             saveImage(proConfidence, path+"/proConfidence.exr");
             saveImage(proMap, path+"/proMap.png");
+            
+            // numbers to judge the scan by, and a line for the ones that fail
+            const ofJson& limits = settings["metrics"];
+            CalibrationMetrics metrics = computeCalibrationMetrics(proConfidence, proMap, camConfidence, Mat(),
+                                                                   getProjectorRegions(settings), limits["confidenceThreshold"]);
+            saveCalibrationMetrics(metrics, path);
+            string failures;
+            if(!checkCalibrationMetrics(metrics, limits, failures)) {
+                ofLogWarning() << scanName << " fails the metrics:\n" << failures;
+                metricsText += scanName + "\n" + failures;
+            }
+            
+#ifdef USE_PROMAP_MESH
+            // the mesh already interpolated sub-pixel camera positions
+            if(usePhase) {
+                saveImage(proMapFine, path+"/proMapFine.exr");
+            }
+#else
+            if(usePhase) {
+                Mat proMapFine;
+                refineProMap(proConfidence, proMap, refinedVertical, refinedHorizontal, proMapFine);
+                saveImage(proMapFine, path+"/proMapFine.exr");
+            }
+#endif
         }
     }
     time = ofGetElapsedTimef();
@@ -492,4 +551,7 @@ void ofApp::draw() {
     ofBackground(30);
     ofSetColor(200);
     ofDrawBitmapString("I'm done....\nIt took me "+ofToString(time)+" seconds", ofPoint(10,20));
+    if(!metricsText.empty()) {
+        ofDrawBitmapString("Scans failing the metrics:\n"+metricsText, ofPoint(10,60));
+    }
 }
@@ -26,7 +26,10 @@ public:
     
     ofxCv::Calibration calibration;
     int time;
+    string metricsText;
 
     void processImageSet(ofFile fileNormal, ofFile fileInverse, ofImage *& imageNormal, ofImage *& imageInverse, const cv::Mat cameraMask, cv::Mat referenceImage, string name);
+    void alignImage(cv::Mat image, cv::Mat match, cv::Mat referenceImage, string name);
+    vector<cv::Mat> loadPhaseImages(string path, const cv::Mat cameraMask, cv::Mat referenceImage, string name);
 
 };
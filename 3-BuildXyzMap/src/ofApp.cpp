@@ -1,25 +1,25 @@
 #include "ofApp.h"
 
 #include "LightLeaksUtilities.h"
+#include "ofxProCamToolkit.h"
+#include "StereoCalibration.h"
+#include "CalibrationMetrics.h"
+#include "AutoMask.h"
+#include "ConnectedComponents.h"
 
 using namespace cv;
 using namespace ofxCv;
 
-template <class T>
-void removeIslands(ofPixels_<T>& img) {
-    int w = img.getWidth(), h = img.getHeight();
-    int ia1=-w-1,ia2=-w-0,ia3=-w+1,ib1=-0-1,ib3=-0+1,ic1=+w-1,ic2=+w-0,ic3=+w+1;
-    T* p = img.getData();
-    for(int y = 1; y + 1 < h; y++) {
-        for(int x = 1; x + 1 < w; x++) {
-            int i = y * w + x;
-            if(p[i]) {
-                if(!p[i+ia1]&&!p[i+ia2]&&!p[i+ia3]&&!p[i+ib1]&&!p[i+ib3]&&!p[i+ic1]&&!p[i+ic2]&&!p[i+ic3]) {
-                    p[i] = 0;
-                }
-            }
-        }
-    }
+// zeroes the pixels of confidence at or below minConfidence, and the islands of
+// confident pixels smaller than minArea. returns how many confident pixels went
+int removeIslands(Mat& confidence, float minConfidence, int minArea) {
+    Mat1b foreground = confidence > minConfidence;
+    ConnectedComponents components;
+    components.label(foreground.ptr(), foreground.cols, foreground.rows, foreground.step);
+    int removed = components.countSmall(minArea);
+    components.fillMask(foreground.ptr(), foreground.step, minArea);
+    confidence.setTo(0, foreground == 0);
+    return removed;
 }
 
 void getBoundingBox(const ofMesh& mesh, ofVec3f& min, ofVec3f& max) {
@@ -104,7 +104,8 @@ void ofApp::setup() {
      vector<ofFile> scanNames = getScanNames();
      for(int i = 0; i < scanNames.size(); i++) {
      ofFile scanName = scanNames[i];
-     processScan(scanName);
+     ScanLoad load = requestScan(scanName);
+     processScan(scanName, load);
      }
      
      saveResult();
@@ -172,8 +173,11 @@ void ofApp::draw() {
     ofDrawBitmapString("space - Show output points", 10, 40);
     ofDrawBitmapString("c - Clear", 10, 55);
     ofDrawBitmapString("s - Save output", 10, 70);
+    ofDrawBitmapString("t - Triangulate all scans without the model", 10, 85);
+    ofDrawBitmapString("e - Export point cloud", 10, 100);
+    ofDrawBitmapString("m - Build masks from the scans", 10, 115);
     
-    ofDrawBitmapString(statusText, 10, 100);
+    ofDrawBitmapString(statusText, 10, 145);
     
     
     
@@ -183,12 +187,22 @@ void ofApp::draw() {
 void ofApp::dragged(ofDragInfo & drag){
 //    statusText = "";
     
-    for(int i=0;i<drag.files.size();i++){
+    // the next scan decodes while this one is merged
+    int n = drag.files.size();
+    ScanLoad next;
+    if(n > 0) {
+        next = requestScan(ofFile(drag.files[0]));
+    }
+    for(int i=0;i<n;i++){
         ofLog()<<drag.files[i];
         ofFile f = ofFile(drag.files[i]);
-        processScan(f);
-
+        ScanLoad load = std::move(next);
+        if(i + 1 < n) {
+            next = requestScan(ofFile(drag.files[i + 1]));
+        }
+        processScan(f, load);
     }
+    ofLogNotice() << "load times:\n" << loader.getReport();
     
     meshOutput.clear();
     int w = proXyzCombined.cols, h = proXyzCombined.rows;
@@ -212,6 +226,15 @@ void ofApp::keyPressed( int key ){
         saveResult();
         ofLog()<<"Save done";
     }
+    if(key == 'e'){
+        exportPointCloud();
+    }
+    if(key == 't'){
+        stereoCalibrateScans();
+    }
+    if(key == 'm'){
+        buildMasks();
+    }
     if(key=='c'){
         proXyzCombined = Mat::zeros(0,0, CV_32FC4);
         proDistCombined = Mat::zeros(0,0, CV_32FC1);
@@ -459,7 +482,168 @@ void ofApp::autoCalibrateXyz(string path, cv::Mat proConfidenceMat, cv::Mat proM
     
 }
 
-void ofApp::processScan(ofFile scanName){
+// calibrates the camera and projectors from the proMaps alone and fills the combined
+// maps with the triangulated points, so 's' saves an xyzMap built without model.dae
+void ofApp::stereoCalibrateScans(){
+    ofJson settings = ofLoadJson("settings.json");
+    const ofJson& stereo = settings["stereo"];
+    
+    vector<string> scanPaths;
+    for(ofFile scan : getScanNames()) {
+        if(scan.isDirectory() && ofFile(scan.path() + "/proMap.png").exists()) {
+            scanPaths.push_back(scan.path());
+        }
+    }
+    cv::Size cameraSize;
+    vector<StereoPair> pairs = loadStereoPairs(scanPaths, settings, stereo["confidenceThreshold"], cameraSize);
+    if(pairs.empty()) {
+        statusText += "\nStereo: no scans with proMaps";
+        return;
+    }
+    
+    float start = ofGetElapsedTimef();
+    StereoIntrinsics camera;
+    vector<StereoIntrinsics> projectors;
+    stereoCalibrate(pairs, cameraSize, settings, camera, projectors);
+    
+    int w = 0, h = 0;
+    for(auto p : settings["projectors"]){
+        w = MAX(w, int(p["width"]) + int(p["xcode"]));
+        h = MAX(h, int(p["height"]) + int(p["ycode"]));
+    }
+    stereoTriangulateAll(pairs, cameraSize, cv::Size(w, h), camera, projectors);
+    
+    Mat residualMap;
+    stereoBuildXyzMap(pairs, cv::Size(w, h), stereo["maxResidual"],
+                      proXyzCombined, proConfidenceCombined, residualMap,
+                      range, zero);
+    proDistCombined = Mat::zeros(h, w, CV_32FC1);
+    saveImage(residualMap, "_stereoResidual.exr");
+    
+    // color the points by scan like processScan does
+    debugViewOutput.allocate(w, h, OF_IMAGE_COLOR);
+    debugViewOutput.setColor(ofColor(0));
+    mesh.clear();
+    meshOutput.clear();
+    for(const StereoPair& pair : pairs) {
+        for(int i = 0; i < pair.positions.size(); i++) {
+            const cv::Point& pixel = pair.proPixels[i];
+            if(proConfidenceCombined.at<float>(pixel) > 0) {
+                debugViewOutput.setColor(pixel.x, pixel.y, colors[pair.scan % 10]);
+            }
+        }
+    }
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            if(proConfidenceCombined.at<float>(y, x) > 0) {
+                Vec4f xyz = proXyzCombined.at<Vec4f>(y, x);
+                meshOutput.addVertex(ofVec3f(xyz[0], xyz[1], xyz[2]) * range + zero);
+                meshOutput.addColor(debugViewOutput.getColor(x, y));
+            }
+        }
+    }
+    mesh = meshOutput;
+    cam.setTarget(zero + ofVec3f(range / 2));
+    
+    statusText += "\nStereo: " + ofToString(pairs.size()) + " scan/projector pairs in " + ofToString(ofGetElapsedTimef() - start, 1) + "s";
+    statusText += "\nCamera rms " + ofToString(camera.rms);
+    for(int i = 0; i < projectors.size(); i++) {
+        statusText += "\nProjector " + ofToString(i) + " rms " + ofToString(projectors[i].rms);
+    }
+    
+    // the combined map has no single proMap or camera, so only coverage and reprojection
+    const ofJson& limits = settings["metrics"];
+    CalibrationMetrics metrics = computeCalibrationMetrics(proConfidenceCombined, Mat(), Mat(), residualMap,
+                                                           getProjectorRegions(settings), limits["confidenceThreshold"]);
+    saveCalibrationMetrics(metrics, ".");
+    for(const ProjectorMetrics& p : metrics.projectors) {
+        statusText += "\nProjector " + ofToString(p.index) + " coverage " + ofToString(100 * p.coverage, 1) + "%";
+        statusText += ", reprojection p95 " + ofToString(p.p95Reprojection, 2) + "px";
+    }
+    string failures;
+    if(!checkCalibrationMetrics(metrics, limits, failures)) {
+        statusText += "\nFails the metrics:\n" + failures;
+    }
+}
+
+// writes mask.png and mask-N.png from where the scans saw the projectors, so
+// saveResult and the other apps can use them without painting any by hand
+void ofApp::buildMasks(){
+    ofJson settings = ofLoadJson("settings.json");
+    float start = ofGetElapsedTimef();
+    
+    // scanned with a mask, proConfidence is already cut by it and ProCamScan
+    // keeps the unmasked one next to it
+    vector<std::future<ofFloatPixels>> loads;
+    for(ofFile scan : getScanNames()) {
+        if(!scan.isDirectory()) {
+            continue;
+        }
+        if(ofFile(scan.path() + "/proConfidenceUnmasked.exr").exists()) {
+            loads.push_back(loader.loadFloat(scan.path() + "/proConfidenceUnmasked.exr"));
+        } else if(ofFile(scan.path() + "/proConfidence.exr").exists()) {
+            loads.push_back(loader.loadFloat(scan.path() + "/proConfidence.exr"));
+        }
+    }
+    vector<ofFloatPixels> pixels;
+    vector<Mat> confidences;
+    for(auto& load : loads) {
+        pixels.push_back(load.get());
+    }
+    for(ofFloatPixels& cur : pixels) {
+        if(cur.isAllocated()) {
+            confidences.push_back(toCv(cur));
+        }
+    }
+    if(confidences.empty()) {
+        statusText += "\nMasks: no scans with proConfidence";
+        return;
+    }
+    
+    Mat1b combined;
+    vector<Mat1b> masks = buildAutoMasks(confidences, getProjectorRegions(settings),
+                                         getAutoMaskSettings(settings["autoMask"]), combined);
+    saveAutoMasks(masks, combined, ofToDataPath(""));
+    statusText += "\nMasks: " + ofToString(masks.size()) + " projectors from " + ofToString(confidences.size()) + " scans in " + ofToString(ofGetElapsedTimef() - start, 1) + "s";
+}
+
+// the combined result as a ply, colored like the debug view, with confidence
+void ofApp::exportPointCloud(){
+    int w = proXyzCombined.cols, h = proXyzCombined.rows;
+    ofMesh cloud;
+    vector<float> confidence;
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            float curConfidence = proConfidenceCombined.at<float>(y, x);
+            if(curConfidence > 0) {
+                Vec4f xyz = proXyzCombined.at<Vec4f>(y, x);
+                cloud.addVertex(ofVec3f(xyz[0], xyz[1], xyz[2]) * range + zero);
+                cloud.addColor(debugViewOutput.getColor(x, y));
+                confidence.push_back(curConfidence);
+            }
+        }
+    }
+    exportPlyCloud("_pointCloud.ply", cloud, confidence);
+    statusText += "\nExported " + ofToString(cloud.getNumVertices()) + " points to _pointCloud.ply";
+}
+
+ScanLoad ofApp::requestScan(ofFile scanName) {
+    ScanLoad load;
+    string path = scanName.path();
+    if(scanName.isDirectory() && path[0] != '_') {
+        load.proConfidence = loader.loadFloat(path + "/proConfidence.exr");
+        load.proMap = loader.loadShort(path + "/proMap.png");
+        if(ofFile(path + "/xyzMap.exr").exists()) {
+            load.xyzMap = loader.loadFloat(path + "/xyzMap.exr");
+        }
+        if(ofFile(path + "/proMapFine.exr").exists()) {
+            load.proMapFine = loader.loadFloat(path + "/proMapFine.exr");
+        }
+    }
+    return load;
+}
+
+void ofApp::processScan(ofFile scanName, ScanLoad& load){
     string path = scanName.path();
     
     statusText += "\n\nProcess "+scanName.getFileName();
@@ -482,26 +666,35 @@ void ofApp::processScan(ofFile scanName){
         ofLog()<<"confidenceMultiplier "<<confidenceMultiplier;
         
         ofLogVerbose() << "processing " << path;
-        ofFloatImage xyzMap, proConfidence, normalMap;
-        ofShortImage proMap;
-        
-        proConfidence.load(path + "/proConfidence.exr");
-        proMap.load(path + "/proMap.png");
+        // decoded by the loader since requestScan, these only wait if it isn't done yet
+        ofFloatPixels proConfidence = load.proConfidence.get();
+        ofShortPixels proMap = load.proMap.get();
         
         Mat proConfidenceMat = toCv(proConfidence);
         Mat proMapMat = toCv(proMap);
         
-        xyzMap.load(path + "/xyzMap.exr");
-        //normalMap.load(path + "/normalMap.exr");
+        ofFloatPixels xyzMap;
+        if(load.xyzMap.valid()) {
+            xyzMap = load.xyzMap.get();
+        }
         
         if(!xyzMap.isAllocated()){
             cout << "No xyzmap for " << scanName.getBaseName() << endl;
             autoCalibrateXyz(path, proConfidenceMat, proMapMat);
-            xyzMap.load(path + "/xyzMap.exr");
+            ofLoadImage(xyzMap, path + "/xyzMap.exr");
         }
         
         Mat xyzMapMat = toCv(xyzMap);
-        //Mat normalMapMat = toCv(normalMap);
+        
+        // sub-pixel camera coordinates from ProCamScan, if the scan has phase patterns
+        ofFloatPixels proMapFine;
+        Mat proMapFineMat;
+        if(load.proMapFine.valid()) {
+            proMapFine = load.proMapFine.get();
+            proMapFineMat = toCv(proMapFine);
+            ofLogVerbose() << "using phase refined proMapFine";
+        }
+        Mat proXyz = sampleXyzMap(proMapMat, proMapFineMat, xyzMapMat, scaleFactor);
         
         int w = proMapMat.cols, h = proMapMat.rows;
         if(proXyzCombined.cols == 0) {
@@ -513,78 +706,35 @@ void ofApp::processScan(ofFile scanName){
             proDistCombined = Mat::zeros(h, w, CV_32FC1);
         }
         
-        // loop through once to compute the mean xyz points weighted by confidence
-        ofVec3f pointSum;
-        float pointWeights = 0;
-        for(int y = 0; y < h; y++) {
-            for(int x = 0; x < w; x++) {
-                const float& curConfidence = proConfidenceMat.at<float>(y, x);
-                if(curConfidence > confidenceThreshold) {
-                    const Vec3w& cur = proMapMat.at<Vec3w>(y, x);
-                    const Vec4f& xyzNorm = xyzMapMat.at<Vec4f>(cur[1] / scaleFactor, cur[0] / scaleFactor);
-                    ofVec3f xyz(xyzNorm[0], xyzNorm[1], xyzNorm[2]);
-                    xyz = xyz * range + zero;
-                    pointSum += xyz * curConfidence;
-                    pointWeights += curConfidence;
-                }
-            }
-        }
-        ofVec3f pointMean = pointSum / pointWeights;
+        Mat updated;
+        ofVec3f pointMean = mergeScanXyz(proConfidenceMat, proXyz,
+                                         confidenceThreshold, confidenceMultiplier,
+                                         range, zero,
+                                         proXyzCombined, proConfidenceCombined, proDistCombined,
+                                         updated);
         ofLog() << "mean point: " << pointMean;
         meanPoints.addVertex(pointMean);
         meanPoints.addColor(colors[colorCounter%10]);
         
-        // loop through again to compute distances from the mean
-        Mat dist = Mat::zeros(h, w, CV_32FC1);
-        for(int y = 0; y < h; y++) {
-            for(int x = 0; x < w; x++) {
-                const float& curConfidence = proConfidenceMat.at<float>(y, x);
-                if(curConfidence > confidenceThreshold) {
-                    const Vec3w& cur = proMapMat.at<Vec3w>(y, x);
-                    const Vec4f& xyzNorm = xyzMapMat.at<Vec4f>(cur[1] / scaleFactor, cur[0] / scaleFactor);
-                    ofVec3f xyz(xyzNorm[0], xyzNorm[1], xyzNorm[2]);
-                    xyz = xyz * range + zero;
-                    dist.at<float>(y, x) = xyz.distance(pointMean);
-                }
-            }
-        }
-        
-        // resolve these confidences and distances relative to all the others
         for(int y = 0; y < h; y++) {
             for(int x = 0; x < w; x++) {
                 const float& curConfidence = proConfidenceMat.at<float>(y, x) * confidenceMultiplier;
-                
                 if(curConfidence > confidenceThreshold) {
-                    const float& curDist = dist.at<float>(y, x);
-                    const Vec3w& cur = proMapMat.at<Vec3w>(y, x); // this is just 2d
-                    const Vec4f& xyzNorm = xyzMapMat.at<Vec4f>(cur[1] / scaleFactor, cur[0] / scaleFactor); // this is just 3d
-                    
-                    float& confidenceCombined = proConfidenceCombined.at<float>(y, x);
-                    float& combinedDist = proDistCombined.at<float>(y, x);
-                    
-                    // one way to rectify this is to only use a pixel if the confidence is also better
-                    // within a threshold than the previous confidence
-//                    if(curConfidence > confidenceCombined * viewBetternes) {
-                    if(combinedDist == 0 || (curDist > 0 && curDist < combinedDist)) {
-                        combinedDist = curDist;
-                        confidenceCombined = curConfidence;
-                        proXyzCombined.at<Vec4f>(y, x) = xyzNorm;
+                    const Vec4f& xyzNorm = proXyz.at<Vec4f>(y, x);
+                    if(updated.at<unsigned char>(y, x)) {
                         if(isTotal){
                             proXyzTotalCombined.at<Vec4f>(y, x) = xyzNorm;
                         }
-                        //proNormalCombined.at<Vec4f>(y, x) = normalMapMat.at<Vec4f>(cur[1] / scaleFactor, cur[0] / scaleFactor);
-                        
                         ofColor c = colors[colorCounter%10];
                         debugViewOutput.setColor(x,y,c);
                     }
-                
+                    
                     ofVec3f xyz(xyzNorm[0], xyzNorm[1], xyzNorm[2]);
                     xyz = xyz * range + zero;
                     mesh.addVertex(xyz);
                     mesh.addColor(colors[colorCounter%10]);
                 }
             }
-            
         }
         
     }
@@ -616,17 +766,20 @@ void ofApp::saveResult(){
 //    proXyzCombined &= maskMat;
 //    proConfidenceCombined *= maskMat;
     
-    toOf(proXyzCombined, proMapFinal);
-    //toOf(proNormalCombined, proNormalFinal);
-    toOf(proConfidenceCombined, proConfidenceFinal);
-    
-    removeIslands(proConfidenceFinal);
+    // islands go from the confidence first, so xyz, confidence and the debug
+    // view below all lose the same pixels
+    ofJson settings = ofLoadJson("settings.json");
+    const ofJson& buildXyz = settings["buildXyz"];
+    int removed = removeIslands(proConfidenceCombined, buildXyz["islandMinConfidence"], buildXyz["islandMinArea"]);
+    ofLogVerbose() << "removed " << removed << " pixels in islands";
     
+    meshOutput.clear();
     for(int y = 0; y < h; y++) {
         for(int x = 0; x < w; x++) {
             if(!proConfidenceCombined.at<float>(y, x) || mask.getColor(x, y).r < 128) {
                 proXyzCombined.at<Vec4f>(y, x) = Vec4f(0, 0, 0, 0);
                 proConfidenceCombined.at<float>(y, x) = 0;
+                debugViewOutput.setColor(x, y, ofColor(0));
 //                proNormalCombined.at<Vec4f>(y, x) = Vec4f(0, 0, 0, 0);
             } else {
                 ofColor c =debugViewOutput.getColor(x,y);
@@ -637,6 +790,11 @@ void ofApp::saveResult(){
             }
         }
     }
+    debugViewOutput.update();
+    
+    toOf(proXyzCombined, proMapFinal);
+    //toOf(proNormalCombined, proNormalFinal);
+    toOf(proConfidenceCombined, proConfidenceFinal);
 
     ofLogVerbose() << "saving images";
     ofSaveImage(proConfidenceFinal, "confidenceMap.exr");
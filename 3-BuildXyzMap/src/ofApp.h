@@ -3,7 +3,13 @@
 #include "ofMain.h"
 #include "ofxCv.h"
 #include "ofxAssimpModelLoader.h"
+#include "AssetLoader.h"
 
+// the files of one scan, decoding in the background
+struct ScanLoad {
+    std::future<ofFloatPixels> proConfidence, xyzMap, proMapFine;
+    std::future<ofShortPixels> proMap;
+};
 
 class ofApp : public ofBaseApp {
 public:
@@ -14,7 +20,11 @@ public:
     void keyPressed( int key );
 
     void autoCalibrateXyz(string path, cv::Mat proConfidenceMat, cv::Mat proMapMat);
-    void processScan(ofFile scanName);
+    ScanLoad requestScan(ofFile scanName);
+    void processScan(ofFile scanName, ScanLoad& load);
+    void stereoCalibrateScans();
+    void buildMasks();
+    void exportPointCloud();
     void saveResult();
     
 	
@@ -52,6 +62,8 @@ public:
     
     bool totalFound;
     string statusText;
+    
+    AssetLoader loader;
 
     
     ofImage debugViewOutput;
@@ -6,8 +6,10 @@
 
 uniform sampler2DRect xyzMap;
 uniform sampler2DRect normalMap;
-uniform sampler2DRect confidenceMap;
 uniform int useConfidence;
+// angle around center, distance from center, height, confidence. see GeometryAttributes
+uniform sampler2DRect attributeMap;
+uniform int useAttributes;
 
 uniform float elapsedTime;
 
@@ -18,6 +20,8 @@ uniform float beamWidth;
 //Spotlight
 uniform float spotlightSize;
 uniform vec3 spotlightPos;
+uniform vec3 spotlights[8];
+uniform int spotlightCount;
 
 uniform int stage;
 uniform int substage;
@@ -43,10 +47,30 @@ float sinp(float x) {
 
 void main() {
     vec2 projectionOffset = vec2(0);//+vec2(floor( sin(elapsedTime*1)*10) ,0);
-    vec3 position = texture2DRect(xyzMap, gl_TexCoord[0].st + projectionOffset).xyz;
+    
+    // only the spotlight, linescan and a few intermezzos need the raw position
+    bool needsPosition = useAttributes == 0 || stage == 1 || stage == 3 ||
+        (stage == 2 && (substage == 1 || substage == 3 || substage == 4));
+    vec3 position = vec3(0.);
+    if(needsPosition) {
+        position = texture2DRect(xyzMap, gl_TexCoord[0].st + projectionOffset).xyz;
+    }
     vec3 centered = position - center;
-    vec3 normal = texture2DRect(normalMap, gl_TexCoord[0].st + projectionOffset).xyz;
-    float confidence = texture2DRect(confidenceMap, gl_TexCoord[0].st).r;
+    
+    float angle, radius, height, confidence;
+    if(useAttributes == 1) {
+        vec4 attributes = texture2DRect(attributeMap, gl_TexCoord[0].st + projectionOffset);
+        angle = attributes.r;
+        radius = attributes.g;
+        height = attributes.b;
+        confidence = attributes.a;
+    } else {
+        angle = atan(centered.y, centered.x);
+        radius = length(centered);
+        height = position.z;
+        // confidence is only kept baked into the attributes
+        confidence = texture2DRect(attributeMap, gl_TexCoord[0].st + projectionOffset).a;
+    }
     if(useConfidence == 0) {
         confidence = 1.;
     }
@@ -63,14 +87,19 @@ void main() {
     time = elapsedTime + sin(elapsedTime); // step time
     // handle space
     if(stage == 0) {
-        //Lighthouse beam
-        vec2 rotated = rotate(centered.xy, beamAngle);
-        float positionAngle = atan(rotated.y, rotated.x);
+        //Lighthouse beam, rotating by beamAngle adds it to the angle
+        float positionAngle = mod(angle + beamAngle + PI, TWO_PI) - PI;
         b = 1. - ((positionAngle + PI) / TWO_PI);
     }
     else if(stage == 1){
         //Spotlight
         float spotlightDistance = length(position - spotlightPos) / spotlightSize;
+        // follow every tracked visitor when there is more than one
+        for(int i = 0; i < 8; i++) {
+            if(i < spotlightCount) {
+                spotlightDistance = min(spotlightDistance, length(position - spotlights[i]) / spotlightSize);
+            }
+        }
         b = 0;
         if(spotlightDistance < 1) {
             b += smoothStep(1. - spotlightDistance);
@@ -83,7 +112,7 @@ void main() {
     } else if(stage == 2) {
         if(substage < 1) {
             // fast rising stripes
-            b = mod(position.z * 10. - time * 1.5, 1.);
+            b = mod(height * 10. - time * 1.5, 1.);
             b *= b;
         } else if(substage < 2) {
             // glittering floor
@@ -92,7 +121,7 @@ void main() {
             b = sin(50. * dot(rot, centered.xy));
         } else if(substage < 3) {
             // concentric spheres
-            b = sin(200.*mod(length(centered)+(0.02*sin(time*1.)), 10.));
+            b = sin(200.*mod(radius+(0.02*sin(time*1.)), 10.));
         } else if(substage < 4) {
             // unstable floor
             float t = sin(time)*.25;
@@ -108,7 +137,7 @@ void main() {
             }
         } else if(substage < 6) {
             // slower rising stripes
-            b = mod(position.z - time * 0.5, 1.);
+            b = mod(height - time * 0.5, 1.);
             b *= b;
         }
     }
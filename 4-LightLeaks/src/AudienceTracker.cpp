@@ -0,0 +1,222 @@
+#include "AudienceTracker.h"
+
+#include "Poco/DateTimeFormat.h"
+
+void AudienceLog::setup(string filename, float flushInterval) {
+    this->filename = filename;
+    this->flushInterval = flushInterval;
+    startThread();
+}
+
+void AudienceLog::add(const string& line) {
+    lines.send(line);
+}
+
+void AudienceLog::close() {
+    // an empty line after everything else tells the thread to finish. closing the
+    // channel first would drop whatever is still queued, receive and tryReceive
+    // both give up as soon as it is closed
+    lines.send("");
+    waitForThread(true);
+    lines.close();
+}
+
+void AudienceLog::threadedFunction() {
+    ofFile out(filename, ofFile::Append);
+    string line, batch;
+    bool done = false;
+    while(!done && lines.receive(line)) {
+        batch.clear();
+        do {
+            if(line.empty()) {
+                done = true;
+                break;
+            }
+            batch += line + "\n";
+        } while(lines.tryReceive(line));
+        out << batch;
+        out.flush();
+        if(!done && isThreadRunning()) {
+            sleep(flushInterval * 1000);
+        }
+    }
+}
+
+AudienceTracker::AudienceTracker()
+:lastFrameTime(0)
+,firstFrame(true)
+,frameCount(0)
+,logging(false)
+,writeSlot(0)
+,sharedSlot(1)
+,readSlot(2)
+,photoRequested(false) {
+}
+
+void AudienceTracker::setup(shared_ptr<FrameSource> source, bool threaded, string logFile) {
+    this->source = source;
+#ifdef USE_FIXED_POINT_TRACKER
+    engine.learningShift = roundf(log2f(backgroundLearningTime));
+    engine.blurRadius = foregroundBlur / 2;
+    engine.dilateRadius = foregroundDilate;
+    engine.threshold = contourFinderThreshold;
+    engine.minAreaRadius = minAreaRadius;
+    engine.maxAreaRadius = maxAreaRadius;
+#else
+    contourFinder.setSortBySize(true); // makes sorting consistent
+    contourFinder.setMinAreaRadius(minAreaRadius);
+    contourFinder.setMaxAreaRadius(maxAreaRadius);
+#endif
+    logging = !logFile.empty();
+    if(logging) {
+        log.setup(logFile, 1);
+    }
+    if(threaded) {
+        startThread();
+    }
+}
+
+void AudienceTracker::close() {
+    waitForThread(true);
+    if(logging) {
+        log.close();
+    }
+    source->close();
+}
+
+FrameSource& AudienceTracker::getSource() {
+    return *source;
+}
+
+void AudienceTracker::requestPhoto() {
+    photoRequested = true;
+}
+
+// a triple buffer: the writer and the reader each own a slot and swap it with
+// the shared one, so the slot being copied is never the one being written. the
+// fresh bit on the shared index says whether the writer has put something new
+// there since the reader last took it.
+void AudienceTracker::publish(TrackerResult& result) {
+    result.publishTime = ofGetElapsedTimef();
+    results[writeSlot] = result;
+    writeSlot = sharedSlot.exchange(writeSlot | freshSlot, std::memory_order_acq_rel) & ~freshSlot;
+}
+
+bool AudienceTracker::getLatest(TrackerResult& result) {
+    if(!(sharedSlot.load(std::memory_order_relaxed) & freshSlot)) {
+        return false;
+    }
+    readSlot = sharedSlot.exchange(readSlot, std::memory_order_acq_rel) & ~freshSlot;
+    result = results[readSlot];
+    return true;
+}
+
+bool AudienceTracker::step() {
+    if(!source->update()) {
+        return false;
+    }
+    ofPixels& pixels = source->getGrayPixels();
+    if(pixels.getWidth() > 0) {
+        process(pixels, source->getFrameTime(), source->getArrivalTime());
+    }
+    if(photoRequested) {
+        photoRequested = false;
+        ofDirectory::createDirectory("photos", true, true);
+        ofSaveImage(source->getColorPixels(), "photos/" + ofGetTimestampString() + ".jpg", OF_IMAGE_QUALITY_MEDIUM);
+    }
+    return true;
+}
+
+void AudienceTracker::threadedFunction() {
+    while(isThreadRunning()) {
+        if(!step()) {
+            sleep(1);
+        }
+    }
+}
+
+void AudienceTracker::process(ofPixels& pixels, float frameTime, float arrivalTime) {
+    uint64_t start = ofGetElapsedTimeMicros();
+    TrackerResult result;
+    result.frame = ++frameCount;
+    result.frameTime = frameTime;
+    result.arrivalTime = arrivalTime;
+    detections.clear();
+#ifdef USE_FIXED_POINT_TRACKER
+    if(firstFrame){ // first frame from ofxBlackMagic is useless
+        engine.setup(pixels.getWidth(), pixels.getHeight(), roundf(1 / trackScale));
+        engine.reset();
+    }
+    const vector<TrackerBlob>& blobs = engine.update(pixels);
+    if(logging && blobs.size() > 0){
+        log.add(buildBlobLogLine(blobs));
+    }
+    for(const TrackerBlob& blob : blobs) {
+        detections.push_back(blob.box.getTopLeft() / trackScale); // corresponds to feet due to angle of camera
+    }
+#else
+    ofxCv::resize(pixels, grabberSmall, trackScale, trackScale, cv::INTER_AREA);
+    //            cameraBackground.setDifferenceMode(ofxCv::RunningBackground::BRIGHTER); // works on floor, but not walls or if couches are white
+    cameraBackground.setLearningTime(backgroundLearningTime);
+    cameraBackground.update(grabberSmall, grabberThresholded);
+    if(firstFrame){ // first frame from ofxBlackMagic is useless
+        cameraBackground.reset();
+    }
+    ofxCv::blur(grabberThresholded, foregroundBlur);
+    ofxCv::dilate(grabberThresholded, foregroundDilate);
+    contourFinder.setThreshold(contourFinderThreshold);
+    contourFinder.findContours(grabberThresholded);
+
+    if(logging && contourFinder.size() > 0){
+        log.add(buildContourLogLine(contourFinder));
+    }
+    for(int i = 0; i < contourFinder.size(); i++) {
+        ofRectangle rect = ofxCv::toOf(contourFinder.getBoundingRect(i));
+        detections.push_back(rect.getTopLeft() / trackScale); // corresponds to feet due to angle of camera
+    }
+#endif
+    result.count = detections.size();
+    if(result.count > 0){
+        result.target = detections[0];
+    }
+
+    // from the frames' own times, so replays that run faster or slower than the
+    // recording track the same
+    multiTracker.update(detections, firstFrame ? 0 : frameTime - lastFrameTime);
+    lastFrameTime = frameTime;
+    vector<Track> tracks = multiTracker.getTracks();
+    result.trackCount = tracks.size();
+    std::copy(tracks.begin(), tracks.end(), result.tracks);
+    result.trackMicros = multiTracker.getLastMicros();
+    result.processMicros = ofGetElapsedTimeMicros() - start;
+    publish(result);
+
+    firstFrame = false;
+}
+
+string buildContourLogLine(ofxCv::ContourFinder& finder) {
+    int n = finder.size();
+    vector<string> record;
+    record.push_back(ofGetTimestampString(Poco::DateTimeFormat::ISO8601_FRAC_FORMAT));
+    record.push_back(ofToString(n));
+    for(int i = 0; i < n; i++) {
+        stringstream str;
+        cv::Rect rect = finder.getBoundingRect(i);
+        str << rect.x << " " << rect.y << " " << rect.width << " " << rect.height;
+        record.push_back(str.str());
+    }
+    return ofJoinString(record, "\t");
+}
+
+// same format as buildContourLogLine
+string buildBlobLogLine(const vector<TrackerBlob>& blobs) {
+    vector<string> record;
+    record.push_back(ofGetTimestampString(Poco::DateTimeFormat::ISO8601_FRAC_FORMAT));
+    record.push_back(ofToString(blobs.size()));
+    for(const TrackerBlob& blob : blobs) {
+        stringstream str;
+        str << blob.box.x << " " << blob.box.y << " " << blob.box.width << " " << blob.box.height;
+        record.push_back(str.str());
+    }
+    return ofJoinString(record, "\t");
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ofMain.h"
+
+// run the audience tracker in the app, the frame source is picked in config.xml
+//#define USE_CAMERA
+#define USE_FIXED_POINT_TRACKER
+
+#include "ofxCv.h"
+#include "FrameSource.h"
+#include "FixedPointTracker.h"
+#include "MultiTracker.h"
+#include <atomic>
+
+// appends lines to a file from its own thread. lines are queued without
+// touching the disk and written in batches with the file kept open.
+class AudienceLog : public ofThread {
+public:
+    void setup(string filename, float flushInterval);
+    void add(const string& line);
+    void close();
+
+protected:
+    void threadedFunction();
+
+    ofThreadChannel<string> lines;
+    string filename;
+    float flushInterval;
+};
+
+// what the render thread needs from the latest camera frame
+struct TrackerResult {
+    uint64_t frame = 0; // 0 until the first frame has been processed
+    int count = 0; // number of contours
+    ofVec2f target; // top left of the biggest contour in camera pixels
+    int trackCount = 0;
+    Track tracks[MultiTracker::maxTracks]; // in camera pixels
+    float trackMicros = 0; // time spent matching and filtering this frame
+    float processMicros = 0; // time spent on the whole frame
+    float frameTime = 0; // when the frame was captured, see FrameSource::getFrameTime
+    float arrivalTime = 0; // ofGetElapsedTimef() when the frame reached the tracker
+    float publishTime = 0; // when this result was handed over
+};
+
+// runs the frame source, background subtraction and contour finder on its own thread.
+// results are handed to the render thread through a triple buffer swapped with
+// one atomic index, so neither side ever waits for the other.
+class AudienceTracker : public ofThread {
+public:
+    AudienceTracker();
+    // an empty logFile turns audience logging off
+    void setup(shared_ptr<FrameSource> source, bool threaded = true, string logFile = "log.txt");
+    void close();
+    // processes one frame on the calling thread, false when the source had nothing new
+    bool step();
+    FrameSource& getSource();
+
+    // returns false when nothing new arrived since the last call
+    bool getLatest(TrackerResult& result);
+    // saves the next color frame to photos/
+    void requestPhoto();
+
+    float trackScale = .25; // actual resizing on the image data
+    float backgroundLearningTime = 4; // in frames
+    int foregroundBlur = 15; // after scaling by trackScale
+    int foregroundDilate = 5; // connect disconnected parts. will fail to separate a big group of people.
+    float contourFinderThreshold = 32; // higher blur calls for lower threshold
+    float minAreaRadius = 5; // after scaling by trackScale
+    float maxAreaRadius = 80; // after scaling by trackScale
+
+protected:
+    void threadedFunction();
+    void process(ofPixels& pixels, float frameTime, float arrivalTime);
+    void publish(TrackerResult& result);
+
+    // only touched by the tracker thread
+    shared_ptr<FrameSource> source;
+#ifdef USE_FIXED_POINT_TRACKER
+    FixedPointTracker engine;
+#else
+    cv::Mat grabberSmall, grabberThresholded;
+    ofxCv::RunningBackground cameraBackground;
+    ofxCv::ContourFinder contourFinder;
+#endif
+    MultiTracker multiTracker;
+    vector<ofVec2f> detections;
+    float lastFrameTime;
+    bool firstFrame;
+    uint64_t frameCount;
+    AudienceLog log;
+    bool logging;
+
+    TrackerResult results[3];
+    static const int freshSlot = 4;
+    int writeSlot; // only touched by the tracker thread
+    std::atomic<int> sharedSlot;
+    int readSlot; // only touched by the render thread
+    std::atomic<bool> photoRequested;
+};
+
+string buildContourLogLine(ofxCv::ContourFinder& finder);
+string buildBlobLogLine(const vector<TrackerBlob>& blobs);
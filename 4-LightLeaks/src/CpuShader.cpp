@@ -0,0 +1,131 @@
+#include "CpuShader.h"
+#include "Parallel.h"
+
+namespace {
+    // glsl mod, which floors instead of truncating like fmodf
+    float glslMod(float x, float y) {
+        return x - y * floorf(x / y);
+    }
+
+    float smoothStep(float x) {
+        return 3.*(x*x)-2.*(x*x*x);
+    }
+}
+
+void CpuShader::setup(const ofFloatPixels& xyzMap, const ofFloatPixels& attributeMap, int scale) {
+    width = xyzMap.getWidth() / scale;
+    height = xyzMap.getHeight() / scale;
+    xyz.allocate(width, height, OF_PIXELS_RGB);
+    attributes.allocate(width, height, OF_PIXELS_RGBA);
+    int xyzChannels = xyzMap.getNumChannels();
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            int i = (y * scale) * xyzMap.getWidth() + (x * scale);
+            const float* position = xyzMap.getData() + i * xyzChannels;
+            const float* attribute = attributeMap.getData() + i * 4;
+            float* xyzOut = xyz.getData() + (y * width + x) * 3;
+            float* attributeOut = attributes.getData() + (y * width + x) * 4;
+            for(int c = 0; c < 3; c++) xyzOut[c] = position[c];
+            for(int c = 0; c < 4; c++) attributeOut[c] = attribute[c];
+        }
+    }
+}
+
+void CpuShader::render(const ShowUniforms& uniforms, ofPixels& out) const {
+    if(out.getWidth() != width || out.getHeight() != height || out.getNumChannels() != 1) {
+        out.allocate(width, height, OF_PIXELS_GRAY);
+    }
+    parallelFor(height, [&](int y) {
+        const float* position = xyz.getData() + y * width * 3;
+        const float* attribute = attributes.getData() + y * width * 4;
+        unsigned char* row = out.getData() + y * width;
+        for(int x = 0; x < width; x++) {
+            row[x] = 255 * ofClamp(shade(uniforms, position, attribute), 0, 1);
+            position += 3;
+            attribute += 4;
+        }
+    });
+}
+
+int CpuShader::getWidth() const {
+    return width;
+}
+
+int CpuShader::getHeight() const {
+    return height;
+}
+
+float CpuShader::shade(const ShowUniforms& u, const float* xyz, const float* attributes) {
+    float angle = attributes[0];
+    float radius = attributes[1];
+    float height = attributes[2];
+    float confidence = attributes[3];
+    if(confidence < minConfidence) {
+        return 0;
+    }
+    ofVec3f position(xyz[0], xyz[1], xyz[2]);
+    ofVec3f centered = position - lighthouseCenter;
+
+    float b = 0;
+    float time = u.elapsedTime + sinf(u.elapsedTime); // step time
+    if(u.stage == 0) {
+        //Lighthouse beam, rotating by beamAngle adds it to the angle
+        float positionAngle = glslMod(angle + u.beamAngle + PI, TWO_PI) - PI;
+        b = 1. - ((positionAngle + PI) / TWO_PI);
+    } else if(u.stage == 1) {
+        //Spotlight
+        float spotlightDistance = position.distance(u.spotlightPos) / u.spotlightSize;
+        for(int i = 0; i < u.spotlightCount && i < 8; i++) {
+            spotlightDistance = MIN(spotlightDistance, position.distance(u.spotlights[i]) / u.spotlightSize);
+        }
+        if(spotlightDistance < 1) {
+            b += smoothStep(1. - spotlightDistance);
+        }
+        float stripe = sinf(u.elapsedTime * -3. + spotlightDistance * 10.);
+        if(stripe > .9) {
+            b += 1.;
+        }
+        b = MIN(b, 1.);
+    } else if(u.stage == 2) {
+        if(u.substage < 1) {
+            // fast rising stripes
+            b = glslMod(height * 10. - time * 1.5, 1.);
+            b *= b;
+        } else if(u.substage < 2) {
+            // glittering floor
+            float t = sinf(time)*.5;
+            ofVec2f rot = ofVec2f(sinf(t), cosf(t)) * (1. + sinf(time) * .5) + time;
+            b = sinf(50. * rot.dot(ofVec2f(centered.x, centered.y)));
+        } else if(u.substage < 3) {
+            // concentric spheres
+            b = sinf(200.*glslMod(radius+(0.02*sinf(time*1.)), 10.));
+        } else if(u.substage < 4) {
+            // unstable floor
+            float t = sinf(time)*.25;
+            ofVec2f rot = ofVec2f(sinf(t), cosf(t));
+            b = sinf(50.*rot.dot(ofVec2f(centered.x, centered.z)));
+        } else if(u.substage < 5) {
+            // checkerboard
+            ofVec3f modp(glslMod(time + position.x * 10., 2.),
+                         glslMod(time + position.y * 10., 2.),
+                         glslMod(time + position.z * 10., 2.));
+            if(modp.x > 1) {
+                b = (modp.z < 1 || modp.y > 1) ? 1 : 0;
+            } else {
+                b = (modp.z > 1 || modp.y < 1) ? 1 : 0;
+            }
+        } else if(u.substage < 6) {
+            // slower rising stripes
+            b = glslMod(height - time * 0.5, 1.);
+            b *= b;
+        }
+    } else if(u.stage == 3) {
+        // Linescan, the shader indexes past z for substage 4 which is undefined, here it's 0
+        float scan = u.mouse.x;
+        float dist = fabsf(scan - (u.substage < 3 ? position[u.substage] : 0));
+        if(dist < 0.1) {
+            b = 1.0;
+        }
+    }
+    return b;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ofMain.h"
+
+// shared by the gl path in ofApp, the offline renderer and CpuShader so they bake
+// and shade the same map
+const ofVec3f lighthouseCenter(0.5, .38, 0.); // same as center in shader.frag
+const float minConfidence = .1; // pixels below this are never shaded
+
+// everything ofApp passes to shader.frag for one frame
+struct ShowUniforms {
+    float elapsedTime;
+    float beamAngle;
+    float beamWidth;
+    float spotlightSize;
+    ofVec3f spotlightPos;
+    ofVec3f spotlights[8];
+    int spotlightCount;
+    int stage, substage;
+    float stageAmp;
+    ofVec2f mouse;
+};
+
+// shader.frag evaluated on the cpu, for rendering the show without the venue or
+// a gpu. it reads the same xyz map and baked attributes as the gl path with
+// useAttributes and useConfidence on. any change to shader.frag has to be made
+// here too, the offline renderer's reference frames will catch it when it isn't.
+class CpuShader {
+public:
+    // scale > 1 renders every scale-th pixel, like drawing the map smaller with GL_NEAREST
+    void setup(const ofFloatPixels& xyzMap, const ofFloatPixels& attributes, int scale = 1);
+    // fills a gray image, rows are shaded in parallel
+    void render(const ShowUniforms& uniforms, ofPixels& out) const;
+    int getWidth() const;
+    int getHeight() const;
+
+    // one fragment, position is xyz and attributes is angle, radius, height, confidence
+    static float shade(const ShowUniforms& uniforms, const float* position, const float* attributes);
+
+protected:
+    ofFloatPixels xyz, attributes;
+    int width, height;
+};
@@ -0,0 +1,229 @@
+#include "FixedPointTracker.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+FixedPointTracker::FixedPointTracker()
+:width(0)
+,height(0)
+,factor(1)
+,resetBackground(true) {
+}
+
+void FixedPointTracker::setup(int width, int height, int downsample) {
+    factor = MAX(downsample, 1);
+    this->width = width / factor;
+    this->height = height / factor;
+    small.allocate(this->width, this->height, OF_PIXELS_GRAY);
+    foreground.allocate(this->width, this->height, OF_PIXELS_GRAY);
+    blurred.allocate(this->width, this->height, OF_PIXELS_GRAY);
+    dilated.allocate(this->width, this->height, OF_PIXELS_GRAY);
+    background.assign(this->width * this->height, 0);
+    integral.assign((this->width + 1) * (this->height + 1), 0);
+    reset();
+}
+
+void FixedPointTracker::reset() {
+    resetBackground = true;
+}
+
+const vector<TrackerBlob>& FixedPointTracker::update(const ofPixels& gray) {
+    downsample(gray);
+    updateBackground();
+    // blur then threshold, then dilate the binary mask. same as dilating the
+    // blurred image before thresholding, because dilation is a max filter.
+    boxThreshold(foreground, blurred, blurRadius, threshold);
+    boxThreshold(blurred, dilated, dilateRadius, 0);
+    findBlobs(dilated);
+    return blobs;
+}
+
+const vector<TrackerBlob>& FixedPointTracker::getBlobs() const {
+    return blobs;
+}
+
+const ofPixels& FixedPointTracker::getSmall() const {
+    return small;
+}
+
+const ofPixels& FixedPointTracker::getForeground() const {
+    return dilated;
+}
+
+// area average, like INTER_AREA for integer factors
+void FixedPointTracker::downsample(const ofPixels& gray) {
+    int stride = gray.getWidth();
+    int shift = 0, n = factor * factor;
+    bool pow2 = (n & (n - 1)) == 0;
+    while((1 << shift) < n) shift++;
+    vector<uint32_t> sums(width);
+    for(int y = 0; y < height; y++) {
+        std::fill(sums.begin(), sums.end(), 0);
+        for(int dy = 0; dy < factor; dy++) {
+            const uint8_t* src = gray.getData() + (y * factor + dy) * stride;
+            for(int x = 0; x < width; x++) {
+                const uint8_t* block = src + x * factor;
+                uint32_t sum = 0;
+                for(int dx = 0; dx < factor; dx++) {
+                    sum += block[dx];
+                }
+                sums[x] += sum;
+            }
+        }
+        uint8_t* dst = small.getData() + y * width;
+        for(int x = 0; x < width; x++) {
+            dst[x] = pow2 ? (sums[x] >> shift) : (sums[x] / n);
+        }
+    }
+}
+
+// background += (frame - background) / 2^learningShift in 8.8 fixed point, and
+// foreground = |frame - background| > backgroundThreshold
+void FixedPointTracker::updateBackground() {
+    int n = width * height;
+    const uint8_t* cur = small.getData();
+    uint8_t* fg = foreground.getData();
+    uint16_t* bg = &background[0];
+    if(resetBackground) {
+        for(int i = 0; i < n; i++) {
+            bg[i] = cur[i] << 8;
+            fg[i] = 0;
+        }
+        resetBackground = false;
+        return;
+    }
+    int i = 0;
+#if CV_SIMD128
+    cv::v_uint8x16 limit = cv::v_setall_u8(backgroundThreshold);
+    for(; i + 16 <= n; i += 16) {
+        cv::v_uint16x8 curLo, curHi;
+        cv::v_expand(cv::v_load(cur + i), curLo, curHi);
+        curLo = curLo << 8;
+        curHi = curHi << 8;
+        cv::v_uint16x8 bgLo = cv::v_load(bg + i), bgHi = cv::v_load(bg + i + 8);
+        // 16 bit subtraction saturates, so only one of up and down is non-zero
+        bgLo = bgLo + ((curLo - bgLo) >> learningShift) - ((bgLo - curLo) >> learningShift);
+        bgHi = bgHi + ((curHi - bgHi) >> learningShift) - ((bgHi - curHi) >> learningShift);
+        cv::v_store(bg + i, bgLo);
+        cv::v_store(bg + i + 8, bgHi);
+        cv::v_uint8x16 model = cv::v_pack(bgLo >> 8, bgHi >> 8);
+        cv::v_store(fg + i, cv::v_absdiff(cv::v_load(cur + i), model) > limit);
+    }
+#endif
+    for(; i < n; i++) {
+        int c = cur[i] << 8, b = bg[i];
+        b += (c > b) ? ((c - b) >> learningShift) : -((b - c) >> learningShift);
+        bg[i] = b;
+        fg[i] = abs(cur[i] - (b >> 8)) > backgroundThreshold ? 255 : 0;
+    }
+}
+
+// dst = 255 where the mean of src over the (2 radius + 1)^2 window, clipped to
+// the image, is above minMean
+void FixedPointTracker::boxThreshold(const ofPixels& src, ofPixels& dst, int radius, int minMean) {
+    int stride = width + 1;
+    const uint8_t* in = src.getData();
+    for(int y = 0; y < height; y++) {
+        uint32_t row = 0;
+        uint32_t* above = &integral[y * stride];
+        uint32_t* cur = above + stride;
+        for(int x = 0; x < width; x++) {
+            row += in[y * width + x];
+            cur[x + 1] = above[x + 1] + row;
+        }
+    }
+    uint8_t* out = dst.getData();
+    for(int y = 0; y < height; y++) {
+        int y0 = MAX(y - radius, 0), y1 = MIN(y + radius + 1, height);
+        const uint32_t* top = &integral[y0 * stride];
+        const uint32_t* bottom = &integral[y1 * stride];
+        for(int x = 0; x < width; x++) {
+            int x0 = MAX(x - radius, 0), x1 = MIN(x + radius + 1, width);
+            uint32_t sum = bottom[x1] - bottom[x0] - top[x1] + top[x0];
+            uint32_t count = (x1 - x0) * (y1 - y0);
+            out[y * width + x] = sum > count * minMean ? 255 : 0;
+        }
+    }
+}
+
+int FixedPointTracker::findRoot(int i) {
+    while(runs[i].parent != i) {
+        runs[i].parent = runs[runs[i].parent].parent;
+        i = runs[i].parent;
+    }
+    return i;
+}
+
+// 8-connected components over horizontal runs. each run is joined with the
+// runs of the previous row that touch it, then the runs are summed per root.
+void FixedPointTracker::findBlobs(const ofPixels& mask) {
+    runs.clear();
+    const uint8_t* in = mask.getData();
+    int prevBegin = 0, prevEnd = 0;
+    for(int y = 0; y < height; y++) {
+        const uint8_t* row = in + y * width;
+        int begin = runs.size();
+        int j = prevBegin;
+        for(int x = 0; x < width;) {
+            if(!row[x]) {
+                x++;
+                continue;
+            }
+            Run run;
+            run.y = y;
+            run.x0 = x;
+            while(x < width && row[x]) x++;
+            run.x1 = x;
+            run.parent = runs.size();
+            runs.push_back(run);
+            int i = run.parent;
+            while(j < prevEnd && runs[j].x1 < run.x0) j++;
+            for(int k = j; k < prevEnd && runs[k].x0 <= run.x1; k++) {
+                int a = findRoot(i), b = findRoot(k);
+                if(a != b) {
+                    runs[MAX(a, b)].parent = MIN(a, b);
+                }
+            }
+        }
+        prevBegin = begin;
+        prevEnd = runs.size();
+    }
+
+    struct Stats {
+        int64_t area = 0, sumX = 0, sumY = 0;
+        int x0, y0, x1, y1;
+    };
+    vector<Stats> stats(runs.size());
+    for(int i = 0; i < runs.size(); i++) {
+        const Run& run = runs[i];
+        Stats& cur = stats[findRoot(i)];
+        int length = run.x1 - run.x0;
+        if(cur.area == 0) {
+            cur.x0 = run.x0, cur.x1 = run.x1;
+            cur.y0 = run.y, cur.y1 = run.y + 1;
+        } else {
+            cur.x0 = MIN(cur.x0, run.x0), cur.x1 = MAX(cur.x1, run.x1);
+            cur.y0 = MIN(cur.y0, run.y), cur.y1 = MAX(cur.y1, run.y + 1);
+        }
+        cur.area += length;
+        cur.sumX += (int64_t) (run.x0 + run.x1 - 1) * length / 2;
+        cur.sumY += (int64_t) run.y * length;
+    }
+
+    float minArea = PI * minAreaRadius * minAreaRadius;
+    float maxArea = PI * maxAreaRadius * maxAreaRadius;
+    blobs.clear();
+    for(int i = 0; i < runs.size(); i++) {
+        const Stats& cur = stats[i];
+        if(runs[i].parent != i || cur.area < minArea || cur.area > maxArea) {
+            continue;
+        }
+        TrackerBlob blob;
+        blob.box.set(cur.x0, cur.y0, cur.x1 - cur.x0, cur.y1 - cur.y0);
+        blob.centroid.set((float) cur.sumX / cur.area, (float) cur.sumY / cur.area);
+        blob.area = cur.area;
+        blobs.push_back(blob);
+    }
+    std::sort(blobs.begin(), blobs.end(), [](const TrackerBlob& a, const TrackerBlob& b) {
+        return a.area > b.area;
+    });
+}
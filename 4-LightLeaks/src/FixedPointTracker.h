@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ofMain.h"
+
+struct TrackerBlob {
+    ofRectangle box; // at tracking resolution, like ofxCv::ContourFinder::getBoundingRect
+    ofVec2f centroid;
+    int area;
+};
+
+// integer version of the RunningBackground, blur, dilate and ContourFinder chain.
+// the background is kept in 8.8 fixed point and updated sixteen pixels at a time,
+// the blur and dilation are box sums on an integral image, and blobs come from
+// joining the horizontal runs of neighbouring rows instead of tracing contours.
+class FixedPointTracker {
+public:
+    FixedPointTracker();
+
+    // width and height of the camera frame, downsample is the integer factor to the tracking resolution
+    void setup(int width, int height, int downsample);
+    // the background is replaced by the next frame
+    void reset();
+    // gray frame at camera resolution, returns blobs sorted by area, largest first
+    const vector<TrackerBlob>& update(const ofPixels& gray);
+
+    const vector<TrackerBlob>& getBlobs() const;
+    const ofPixels& getSmall() const;
+    const ofPixels& getForeground() const;
+
+    int learningShift = 2; // the background moves 1 / 2^learningShift of the way per frame
+    int backgroundThreshold = 26; // absolute difference that counts as foreground
+    int blurRadius = 7; // half of the blur size, at tracking resolution
+    int dilateRadius = 5;
+    int threshold = 32; // applied to the blurred foreground
+    float minAreaRadius = 5;
+    float maxAreaRadius = 80;
+
+protected:
+    void downsample(const ofPixels& gray);
+    void updateBackground();
+    void boxThreshold(const ofPixels& src, ofPixels& dst, int radius, int minMean);
+    void findBlobs(const ofPixels& mask);
+    int findRoot(int i);
+
+    struct Run {
+        int y, x0, x1; // x1 is exclusive
+        int parent;
+    };
+
+    int width, height, factor;
+    bool resetBackground;
+    ofPixels small, foreground, blurred, dilated;
+    vector<uint16_t> background;
+    vector<uint32_t> integral;
+    vector<Run> runs;
+    vector<TrackerBlob> blobs;
+};
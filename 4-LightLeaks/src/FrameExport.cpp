@@ -0,0 +1,134 @@
+#include "FrameExport.h"
+
+FrameExport::FrameExport()
+:width(0)
+,height(0)
+,header(NULL)
+,size(0)
+,pboIndex(0)
+,publishMicros(0) {
+    for(int i = 0; i < pboCount; i++) {
+        pboFilled[i] = false;
+    }
+}
+
+FrameExport::~FrameExport() {
+    close();
+}
+
+bool FrameExport::setup(string name, int width, int height, int slotCount) {
+    close();
+    this->name = name;
+    this->width = width;
+    this->height = height;
+
+    uint64_t slotSize;
+    size = getFrameExportSize(width, height, slotCount, slotSize);
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0) {
+        ofLogError("FrameExport") << "can't open shared memory " << name << ": " << strerror(errno);
+        return false;
+    }
+    // a reader from a previous run may still have the old size mapped, start fresh
+    if(ftruncate(fd, 0) < 0 || ftruncate(fd, size) < 0) {
+        ofLogError("FrameExport") << "can't resize shared memory " << name << ": " << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED) {
+        ofLogError("FrameExport") << "can't map shared memory " << name << ": " << strerror(errno);
+        return false;
+    }
+
+    header = (FrameExportHeader*) memory;
+    header->width = width;
+    header->height = height;
+    header->channels = 4;
+    header->slotCount = slotCount;
+    header->slotSize = slotSize;
+    new (&header->published) std::atomic<uint64_t>(0);
+    for(int i = 0; i < slotCount; i++) {
+        new (&getFrameExportSlot(header, i)->sequence) std::atomic<uint64_t>(0);
+    }
+    header->version = frameExportVersion;
+    // readers check the magic last, so they never see a half written header
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = frameExportMagic;
+
+    scaled.allocate(width, height, GL_RGBA);
+    for(int i = 0; i < pboCount; i++) {
+        pbos[i].allocate(width * height * 4, GL_STREAM_READ);
+        pboFilled[i] = false;
+    }
+    pboIndex = 0;
+    ofLogNotice("FrameExport") << "publishing " << width << "x" << height << " to " << name;
+    return true;
+}
+
+void FrameExport::close() {
+    if(header) {
+        munmap(header, size);
+        shm_unlink(name.c_str());
+        header = NULL;
+    }
+}
+
+bool FrameExport::isOpen() const {
+    return header != NULL;
+}
+
+void FrameExport::publish(const ofTexture& frame, const FrameExportState& state) {
+    if(!header) {
+        return;
+    }
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    scaled.begin();
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    ofSetColor(255);
+    frame.draw(0, 0, width, height);
+    ofPopStyle();
+    scaled.end();
+
+    // start reading this frame back, it will be ready by the time we come back to this pbo
+    scaled.getTexture().copyTo(pbos[pboIndex]);
+    pboStates[pboIndex] = state;
+    pboFilled[pboIndex] = true;
+
+    // and copy out the oldest one
+    int oldest = (pboIndex + 1) % pboCount;
+    if(pboFilled[oldest]) {
+        const uint8_t* pixels = pbos[oldest].map<uint8_t>(GL_READ_ONLY);
+        if(pixels) {
+            write(pixels, pboStates[oldest]);
+            pbos[oldest].unmap();
+        }
+        pboFilled[oldest] = false;
+    }
+    pboIndex = oldest;
+    publishMicros = ofGetElapsedTimeMicros() - start;
+}
+
+void FrameExport::write(const uint8_t* pixels, const FrameExportState& state) {
+    uint64_t published = header->published.load(std::memory_order_relaxed);
+    FrameExportSlot* slot = getFrameExportSlot(header, published % header->slotCount);
+    // odd while writing, see FrameExportReader::readLatest
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->state = state;
+    memcpy(getFrameExportPixels(slot), pixels, width * height * 4);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->published.store(published + 1, std::memory_order_release);
+}
+
+uint64_t FrameExport::getPublished() const {
+    return header ? header->published.load(std::memory_order_relaxed) : 0;
+}
+
+float FrameExport::getPublishMicros() const {
+    return publishMicros;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ofMain.h"
+#include "FrameExportReader.h"
+
+// publishes a downscaled copy of the output and the show state into the shared
+// memory ring described in FrameExportReader.h, for previs, recording and
+// monitoring from other processes. the copy is scaled on the gpu and read back
+// through a few pixel buffer objects, so the frame that gets mapped was read
+// pboCount - 1 frames ago and the render thread never waits on the gpu.
+class FrameExport {
+public:
+    static const int pboCount = 3;
+
+    FrameExport();
+    ~FrameExport();
+    bool setup(string name, int width, int height, int slotCount = 4);
+    void close();
+    bool isOpen() const;
+
+    // frame is drawn scaled into the export size
+    void publish(const ofTexture& frame, const FrameExportState& state);
+
+    uint64_t getPublished() const;
+    float getPublishMicros() const; // cpu time of the last publish
+
+protected:
+    void write(const uint8_t* pixels, const FrameExportState& state);
+
+    string name;
+    int width, height;
+    FrameExportHeader* header;
+    size_t size;
+
+    ofFbo scaled;
+    ofBufferObject pbos[pboCount];
+    FrameExportState pboStates[pboCount];
+    bool pboFilled[pboCount];
+    int pboIndex;
+    float publishMicros;
+};
@@ -0,0 +1,244 @@
+#include "FrameSource.h"
+
+#ifdef USE_BLACKMAGIC
+void BlackMagicSource::setup(int width, int height, float framerate) {
+    grabber.setup(width, height, framerate);
+}
+
+bool BlackMagicSource::update() {
+    if(grabber.update()) {
+        frameTime = arrivalTime = ofGetElapsedTimef();
+        return true;
+    }
+    return false;
+}
+
+ofPixels& BlackMagicSource::getGrayPixels() {
+    return grabber.getGrayPixels();
+}
+
+ofPixels& BlackMagicSource::getColorPixels() {
+    return grabber.getColorPixels();
+}
+
+float BlackMagicSource::getFrameTime() const {
+    return frameTime;
+}
+
+void BlackMagicSource::close() {
+    grabber.close();
+}
+#endif
+
+bool RecordingSource::setup(string path, bool realtime, float framerate) {
+    this->realtime = realtime;
+    this->framerate = framerate;
+    ofFile file(path);
+    if(file.isDirectory()) {
+        ofDirectory dir(path);
+        dir.allowExt("jpg");
+        dir.allowExt("png");
+        dir.listDir();
+        dir.sort();
+        for(int i = 0; i < dir.size(); i++) {
+            images.push_back(dir.getPath(i));
+        }
+        if(images.empty()) {
+            ofLogError("RecordingSource") << "no images in " << path;
+            return false;
+        }
+    } else {
+        video.setUseTexture(false);
+        if(!video.load(path)) {
+            ofLogError("RecordingSource") << "can't load " << path;
+            return false;
+        }
+        video.setLoopState(OF_LOOP_NONE);
+        // frame times come from the file's own rate
+        if(video.getDuration() > 0) {
+            this->framerate = video.getTotalNumFrames() / video.getDuration();
+        }
+        if(realtime) {
+            video.play();
+        } else {
+            video.setPaused(true);
+        }
+    }
+    startTime = ofGetElapsedTimef();
+    return true;
+}
+
+bool RecordingSource::due() {
+    return !realtime || ofGetElapsedTimef() - startTime >= frame / framerate;
+}
+
+bool RecordingSource::update() {
+    if(finished) {
+        return false;
+    }
+    if(!images.empty()) {
+        if(!due()) {
+            return false;
+        }
+        if(frame == images.size()) {
+            finished = true;
+            return false;
+        }
+        ofLoadImage(color, images[frame]);
+    } else {
+        if(video.getIsMovieDone() || (!realtime && frame == video.getTotalNumFrames())) {
+            finished = true;
+            return false;
+        }
+        // only step once the last frame was handed out, a call that finds the
+        // decoder still busy must not skip ahead
+        if(!realtime && stepPending) {
+            video.nextFrame();
+            stepPending = false;
+        }
+        video.update();
+        if(!video.isFrameNew()) {
+            return false;
+        }
+        color = video.getPixels();
+        stepPending = true;
+    }
+    gray = color;
+    gray.setImageType(OF_IMAGE_GRAYSCALE);
+    arrivalTime = ofGetElapsedTimef();
+    frameTime = realtime ? arrivalTime : frame / framerate;
+    frame++;
+    return true;
+}
+
+ofPixels& RecordingSource::getGrayPixels() {
+    return gray;
+}
+
+ofPixels& RecordingSource::getColorPixels() {
+    return color;
+}
+
+float RecordingSource::getFrameTime() const {
+    return frameTime;
+}
+
+bool RecordingSource::isFinished() const {
+    return finished;
+}
+
+void RecordingSource::close() {
+    video.close();
+}
+
+void SyntheticSource::setup(int width, int height, int visitors, bool realtime, float framerate, int frames) {
+    this->width = width;
+    this->height = height;
+    this->visitors = visitors;
+    this->realtime = realtime;
+    this->framerate = framerate;
+    this->frames = frames;
+    gray.allocate(width, height, OF_PIXELS_GRAY);
+    color.allocate(width, height, OF_PIXELS_RGB);
+    // a fixed noise pattern that gets offset every frame, cheaper than new noise per pixel
+    ofSeedRandom(0);
+    noise.resize(width * height + width);
+    for(uint8_t& n : noise) {
+        n = ofRandom(16);
+    }
+    startTime = ofGetElapsedTimef();
+}
+
+bool SyntheticSource::update() {
+    if(isFinished()) {
+        return false;
+    }
+    if(realtime && ofGetElapsedTimef() - startTime < frame / framerate) {
+        return false;
+    }
+    render();
+    arrivalTime = ofGetElapsedTimef();
+    frameTime = realtime ? arrivalTime : frame / framerate;
+    frame++;
+    return true;
+}
+
+// the path only depends on the frame number, so runs are repeatable
+void SyntheticSource::render() {
+    uint8_t* pixels = gray.getData();
+    const uint8_t* offset = &noise[(frame * 7) % width];
+    for(int i = 0; i < width * height; i++) {
+        pixels[i] = 60 + offset[i];
+    }
+
+    truth.clear();
+    float t = frame / framerate;
+    if(t >= 1) {
+        for(int i = 0; i < visitors; i++) {
+            float speed = .05 + .02 * i;
+            float x = ofMap(sin(TWO_PI * speed * t + i * 2.1), -1, 1, radius, width - radius);
+            float y = ofMap(sin(TWO_PI * speed * 1.3 * t + i * 1.7), -1, 1, radius, height - radius);
+            truth.push_back(ofVec2f(x - radius, y - radius));
+            int x0 = MAX(x - radius, 0), x1 = MIN(x + radius, width);
+            int y0 = MAX(y - radius, 0), y1 = MIN(y + radius, height);
+            for(int py = y0; py < y1; py++) {
+                for(int px = x0; px < x1; px++) {
+                    if(ofDistSquared(px, py, x, y) < radius * radius) {
+                        pixels[py * width + px] = 200;
+                    }
+                }
+            }
+        }
+    }
+    color.setFromPixels(gray.getData(), width, height, OF_IMAGE_GRAYSCALE);
+    color.setImageType(OF_IMAGE_COLOR);
+}
+
+ofPixels& SyntheticSource::getGrayPixels() {
+    return gray;
+}
+
+ofPixels& SyntheticSource::getColorPixels() {
+    return color;
+}
+
+float SyntheticSource::getFrameTime() const {
+    return frameTime;
+}
+
+bool SyntheticSource::isFinished() const {
+    return frames > 0 && frame >= frames;
+}
+
+const vector<ofVec2f>& SyntheticSource::getTruth() const {
+    return truth;
+}
+
+shared_ptr<FrameSource> createFrameSource(string type, string path, bool realtime) {
+    if(type == "synthetic") {
+        auto source = make_shared<SyntheticSource>();
+        source->setup(1920, 1080, 3, realtime, 25, realtime ? 0 : 1500);
+        return source;
+    }
+    if(type == "video" || type == "images") {
+        auto source = make_shared<RecordingSource>();
+        if(source->setup(path, realtime)) {
+            return source;
+        }
+        return nullptr;
+    }
+#ifdef USE_BLACKMAGIC
+    if(type == "blackmagic") {
+        auto source = make_shared<BlackMagicSource>();
+        source->setup(1920, 1080, 25);
+        return source;
+    }
+#else
+    if(type == "blackmagic") {
+        ofLogError("createFrameSource") << "blackmagic needs USE_BLACKMAGIC in FrameSource.h and ofxBlackMagic in addons.make";
+        return nullptr;
+    }
+#endif
+    ofLogError("createFrameSource") << "unknown frame source " << type;
+    return nullptr;
+}
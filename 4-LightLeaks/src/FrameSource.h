@@ -0,0 +1,107 @@
+#pragma once
+
+#include "ofMain.h"
+
+// the capture card needs ofxBlackMagic in addons.make, the other sources work without it
+//#define USE_BLACKMAGIC
+
+#ifdef USE_BLACKMAGIC
+#include "ofxBlackMagic.h"
+#endif
+
+// where the audience tracker gets its frames from. update() is called from the
+// tracker thread, or from the benchmark when running headless.
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+    // true when a new frame arrived
+    virtual bool update() = 0;
+    virtual ofPixels& getGrayPixels() = 0;
+    virtual ofPixels& getColorPixels() = 0;
+    // when the current frame was captured, in seconds. live and realtime sources
+    // use ofGetElapsedTimef(), the others frame / framerate so a replay behaves
+    // the same however fast it runs
+    virtual float getFrameTime() const = 0;
+    // ofGetElapsedTimef() when update() returned the current frame, for latency
+    float getArrivalTime() const { return arrivalTime; }
+    // true once a recording has run out, live sources never finish
+    virtual bool isFinished() const { return false; }
+    virtual void close() {}
+
+protected:
+    float arrivalTime = 0;
+};
+
+#ifdef USE_BLACKMAGIC
+class BlackMagicSource : public FrameSource {
+public:
+    void setup(int width, int height, float framerate);
+    bool update();
+    ofPixels& getGrayPixels();
+    ofPixels& getColorPixels();
+    float getFrameTime() const;
+    void close();
+
+protected:
+    ofxBlackMagic grabber;
+    float frameTime = 0;
+};
+#endif
+
+// a video file, or a directory of images like the ones saved to photos/.
+// with realtime set, frames arrive at framerate like a camera would deliver them,
+// otherwise every update() returns the next frame as fast as it can be decoded.
+class RecordingSource : public FrameSource {
+public:
+    bool setup(string path, bool realtime, float framerate = 25);
+    bool update();
+    ofPixels& getGrayPixels();
+    ofPixels& getColorPixels();
+    float getFrameTime() const;
+    bool isFinished() const;
+    void close();
+
+protected:
+    bool due();
+
+    bool realtime;
+    float framerate;
+    float startTime = 0, frameTime = 0;
+    int frame = 0;
+    bool finished = false;
+    bool stepPending = false; // a video frame was consumed and the player should move on
+    vector<string> images;
+    ofVideoPlayer video;
+    ofPixels color, gray;
+};
+
+// visitors drawn as bright discs walking lissajous paths over a noisy floor.
+// the room is empty for the first second so the background model can settle.
+class SyntheticSource : public FrameSource {
+public:
+    void setup(int width, int height, int visitors, bool realtime, float framerate = 25, int frames = 0);
+    bool update();
+    ofPixels& getGrayPixels();
+    ofPixels& getColorPixels();
+    float getFrameTime() const;
+    bool isFinished() const;
+
+    // top left of each visitor's bounding box in the current frame, the point the tracker follows
+    const vector<ofVec2f>& getTruth() const;
+    int radius = 60;
+
+protected:
+    void render();
+
+    int width, height, visitors, frames;
+    bool realtime;
+    float framerate;
+    float startTime = 0, frameTime = 0;
+    int frame = 0;
+    vector<uint8_t> noise;
+    vector<ofVec2f> truth;
+    ofPixels color, gray;
+};
+
+// type is blackmagic, video, images or synthetic
+shared_ptr<FrameSource> createFrameSource(string type, string path, bool realtime);
@@ -0,0 +1,211 @@
+#include "GeometryAttributes.h"
+
+void GeometryAttributes::addQuad(ofVboMesh& mesh, float x0, float y0, float x1, float y1) {
+    int i = mesh.getNumVertices();
+    mesh.addVertex(ofVec3f(x0, y0));
+    mesh.addVertex(ofVec3f(x1, y0));
+    mesh.addVertex(ofVec3f(x1, y1));
+    mesh.addVertex(ofVec3f(x0, y1));
+    mesh.addTexCoord(ofVec2f(x0, y0));
+    mesh.addTexCoord(ofVec2f(x1, y0));
+    mesh.addTexCoord(ofVec2f(x1, y1));
+    mesh.addTexCoord(ofVec2f(x0, y1));
+    mesh.addTriangle(i, i + 1, i + 2);
+    mesh.addTriangle(i, i + 2, i + 3);
+}
+
+void GeometryAttributes::bake(const ofFloatPixels& xyzMap, const ofFloatPixels& confidenceMap, ofVec3f center, float minConfidence, ofFloatPixels& attributes) {
+    int width = xyzMap.getWidth();
+    int height = xyzMap.getHeight();
+    attributes.allocate(width, height, OF_PIXELS_RGBA);
+    int xyzChannels = xyzMap.getNumChannels();
+    int confidenceChannels = confidenceMap.getNumChannels();
+    const float* xyz = xyzMap.getData();
+    const float* confidence = confidenceMap.getData();
+    float* out = attributes.getData();
+    for(int i = 0; i < width * height; i++) {
+        const float* position = xyz + i * xyzChannels;
+        float c = confidence[i * confidenceChannels];
+        ofVec3f centered = ofVec3f(position[0], position[1], position[2]) - center;
+        float* cur = out + i * 4;
+        cur[0] = atan2f(centered.y, centered.x);
+        cur[1] = centered.length();
+        cur[2] = position[2];
+        cur[3] = c >= minConfidence ? c : 0;
+    }
+}
+
+void GeometryAttributes::setup(const ofFloatPixels& xyzMap, const ofFloatPixels& confidenceMap, ofVec3f center, float minConfidence, int tileSize) {
+    width = xyzMap.getWidth();
+    height = xyzMap.getHeight();
+    ofFloatPixels attributes;
+    bake(xyzMap, confidenceMap, center, minConfidence, attributes);
+    texture.setup(attributes);
+    runs.clear();
+    runs.setMode(OF_PRIMITIVE_TRIANGLES);
+    validPixels = 0;
+    int tilesWide = (width + tileSize - 1) / tileSize;
+    int tilesHigh = (height + tileSize - 1) / tileSize;
+    vector<bool> tileValid(tilesWide * tilesHigh, false);
+
+    int confidenceChannels = confidenceMap.getNumChannels();
+    const float* confidence = confidenceMap.getData();
+    for(int y = 0; y < height; y++) {
+        int runStart = -1;
+        for(int x = 0; x <= width; x++) {
+            bool valid = false;
+            if(x < width) {
+                valid = confidence[(y * width + x) * confidenceChannels] >= minConfidence;
+            }
+            if(valid && runStart < 0) {
+                runStart = x;
+            } else if(!valid && runStart >= 0) {
+                addQuad(runs, runStart, y, x, y + 1);
+                validPixels += x - runStart;
+                for(int tx = runStart / tileSize; tx <= (x - 1) / tileSize; tx++) {
+                    tileValid[(y / tileSize) * tilesWide + tx] = true;
+                }
+                runStart = -1;
+            }
+        }
+    }
+
+    // neighbouring valid tiles in a row become one quad
+    tiles.clear();
+    tiles.setMode(OF_PRIMITIVE_TRIANGLES);
+    tilePixels = 0;
+    for(ofVboMesh& phase : tilePhases) {
+        phase.clear();
+        phase.setMode(OF_PRIMITIVE_TRIANGLES);
+    }
+    for(int ty = 0; ty < tilesHigh; ty++) {
+        for(int tx = 0; tx < tilesWide; tx++) {
+            if(tileValid[ty * tilesWide + tx]) {
+                float x0 = tx * tileSize, x1 = MIN((tx + 1) * tileSize, width);
+                float y0 = ty * tileSize, y1 = MIN((ty + 1) * tileSize, height);
+                addQuad(tilePhases[(tx % 2) + 2 * (ty % 2)], x0, y0, x1, y1);
+            }
+        }
+    }
+    for(int ty = 0; ty < tilesHigh; ty++) {
+        for(int tx = 0; tx < tilesWide;) {
+            if(!tileValid[ty * tilesWide + tx]) {
+                tx++;
+                continue;
+            }
+            int start = tx;
+            while(tx < tilesWide && tileValid[ty * tilesWide + tx]) tx++;
+            float x0 = start * tileSize, x1 = MIN(tx * tileSize, width);
+            float y0 = ty * tileSize, y1 = MIN((ty + 1) * tileSize, height);
+            addQuad(tiles, x0, y0, x1, y1);
+            tilePixels += (x1 - x0) * (y1 - y0);
+        }
+    }
+
+    full.clear();
+    full.setMode(OF_PRIMITIVE_TRIANGLES);
+    addQuad(full, 0, 0, width, height);
+
+    ofLogNotice("GeometryAttributes") << validPixels << " of " << (width * height) << " pixels valid in " << getRuns() << " runs, "
+        << tilePixels << " pixels in " << (tiles.getNumVertices() / 4) << " tile spans";
+}
+
+void GeometryAttributes::update(int maxStrips) {
+    texture.update(maxStrips);
+}
+
+bool GeometryAttributes::isLoaded() const {
+    return texture.isLoaded();
+}
+
+ofTexture& GeometryAttributes::getTexture() {
+    return texture.getTexture();
+}
+
+size_t GeometryAttributes::getGpuBytes() const {
+    return texture.getGpuBytes();
+}
+
+void GeometryAttributes::drawValid(float x, float y, float w, float h, DrawMode mode) {
+    ofPushMatrix();
+    ofTranslate(x, y);
+    ofScale(w / width, h / height);
+    switch(mode) {
+        case DRAW_TILES: tiles.draw(); break;
+        case DRAW_RUNS: runs.draw(); break;
+        case DRAW_FULL: full.draw(); break;
+    }
+    ofPopMatrix();
+}
+
+void GeometryAttributes::drawTilePhase(float x, float y, float w, float h, int phase) {
+    ofPushMatrix();
+    ofTranslate(x, y);
+    ofScale(w / width, h / height);
+    tilePhases[phase].draw();
+    ofPopMatrix();
+}
+
+int GeometryAttributes::getValidPixels() const {
+    return validPixels;
+}
+
+int GeometryAttributes::getRuns() const {
+    return runs.getNumVertices() / 4;
+}
+
+int GeometryAttributes::getTilePixels() const {
+    return tilePixels;
+}
+
+ShadedPixelCounter::ShadedPixelCounter()
+:current(0)
+,pixels(0) {
+    for(int i = 0; i < queryCount; i++) {
+        queries[i] = 0;
+        pending[i] = false;
+    }
+}
+
+void ShadedPixelCounter::release() {
+    if(queries[0]) {
+        glDeleteQueries(queryCount, queries);
+    }
+    for(int i = 0; i < queryCount; i++) {
+        queries[i] = 0;
+        pending[i] = false;
+    }
+}
+
+void ShadedPixelCounter::begin() {
+    if(!queries[0]) {
+        glGenQueries(queryCount, queries);
+    }
+    // pick up whatever finished since last time without waiting, oldest first
+    for(int i = 1; i <= queryCount; i++) {
+        int query = (current + i) % queryCount;
+        if(pending[query]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(available) {
+                glGetQueryObjectuiv(queries[query], GL_QUERY_RESULT, &pixels);
+                pending[query] = false;
+            }
+        }
+    }
+    current = (current + 1) % queryCount;
+    if(!pending[current]) {
+        glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+    }
+}
+
+void ShadedPixelCounter::end() {
+    if(!pending[current]) {
+        glEndQuery(GL_SAMPLES_PASSED);
+        pending[current] = true;
+    }
+}
+
+GLuint ShadedPixelCounter::getPixels() const {
+    return pixels;
+}
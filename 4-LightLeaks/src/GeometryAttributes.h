@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ofMain.h"
+#include "MapTexture.h"
+
+// the parts of the shader that only depend on where a pixel lands in the room,
+// baked once at load time. the texture holds angle around the lighthouse center,
+// distance from the center, height and confidence, with confidence set to 0
+// below minConfidence. the valid pixels are also collected into horizontal runs,
+// and into tiles that contain at least one valid pixel, so masked pixels never
+// or rarely reach the fragment shader. tiles are the default because one pixel
+// tall runs waste half of every 2x2 block the gpu shades.
+class GeometryAttributes {
+public:
+    enum DrawMode {
+        DRAW_TILES = 0,
+        DRAW_RUNS,
+        DRAW_FULL
+    };
+
+    void setup(const ofFloatPixels& xyzMap, const ofFloatPixels& confidenceMap, ofVec3f center, float minConfidence, int tileSize = 16);
+    // just the per-pixel attributes, without touching gl
+    static void bake(const ofFloatPixels& xyzMap, const ofFloatPixels& confidenceMap, ofVec3f center, float minConfidence, ofFloatPixels& attributes);
+
+    // the texture is uploaded in strips, see MapTexture
+    void update(int maxStrips = 0);
+    bool isLoaded() const;
+    ofTexture& getTexture();
+    size_t getGpuBytes() const;
+    // draws the valid area scaled so the whole map covers w x h, with texture coordinates in map pixels
+    void drawValid(float x, float y, float w, float h, DrawMode mode = DRAW_TILES);
+    // one of four interleaved sets of tiles, picked by the parity of the tile's column and row
+    void drawTilePhase(float x, float y, float w, float h, int phase);
+    int getValidPixels() const;
+    int getRuns() const;
+    // pixels covered by the tiles, at map resolution
+    int getTilePixels() const;
+
+protected:
+    void addQuad(ofVboMesh& mesh, float x0, float y0, float x1, float y1);
+
+    MapTexture texture;
+    ofVboMesh runs, tiles, full;
+    ofVboMesh tilePhases[4];
+    int width, height;
+    int validPixels, tilePixels;
+};
+
+// counts the pixels the fragment shader wrote between begin() and end().
+// results arrive a couple of frames late so reading them never stalls the gpu.
+class ShadedPixelCounter {
+public:
+    ShadedPixelCounter();
+    void begin();
+    void end();
+    // deletes the queries, from the window that counted while its context is
+    // still alive. the destructor leaves gl alone
+    void release();
+    // most recent finished count
+    GLuint getPixels() const;
+
+protected:
+    static const int queryCount = 3;
+    GLuint queries[queryCount];
+    bool pending[queryCount];
+    int current;
+    GLuint pixels;
+};
@@ -0,0 +1,112 @@
+#include "MapTexture.h"
+#include "Parallel.h"
+
+MapTexture::MapTexture()
+:width(0)
+,height(0)
+,channels(0)
+,stripRows(64)
+,uploadedRows(0) {
+}
+
+void MapTexture::setup(const ofFloatPixels& pixels, int stripRows) {
+    width = pixels.getWidth();
+    height = pixels.getHeight();
+    channels = pixels.getNumChannels() == 4 ? 4 : 3;
+    this->stripRows = stripRows;
+    uploadedRows = 0;
+
+    int inChannels = pixels.getNumChannels();
+    staging.resize((size_t) width * height * channels);
+    int strips = (height + stripRows - 1) / stripRows;
+    parallelFor(strips, [&](int strip) {
+        int end = MIN((strip + 1) * stripRows, height);
+        for(int y = strip * stripRows; y < end; y++) {
+            const float* in = pixels.getData() + (size_t) y * width * inChannels;
+            uint16_t* out = staging.data() + (size_t) y * width * channels;
+            for(int x = 0; x < width; x++) {
+                for(int c = 0; c < channels; c++) {
+                    out[c] = toHalf(c < inChannels ? in[c] : 0);
+                }
+                in += inChannels;
+                out += channels;
+            }
+        }
+    });
+
+    int glFormat = channels == 4 ? GL_RGBA : GL_RGB;
+    texture.allocate(width, height, channels == 4 ? GL_RGBA16F : GL_RGB16F, ofGetUsingArbTex(), glFormat, GL_HALF_FLOAT);
+    texture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+}
+
+void MapTexture::update(int maxStrips) {
+    if(isLoaded()) {
+        return;
+    }
+    const ofTextureData& data = texture.getTextureData();
+    int glFormat = channels == 4 ? GL_RGBA : GL_RGB;
+    glBindTexture(data.textureTarget, data.textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    for(int strip = 0; uploadedRows < height && (maxStrips == 0 || strip < maxStrips); strip++) {
+        int rows = MIN(stripRows, height - uploadedRows);
+        size_t bytes = (size_t) rows * width * channels * sizeof(uint16_t);
+        // allocating again orphans the previous strip instead of waiting for it
+        uploadBuffer.allocate(bytes, staging.data() + (size_t) uploadedRows * width * channels, GL_STREAM_DRAW);
+        uploadBuffer.bind(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(data.textureTarget, 0, 0, uploadedRows, width, rows, glFormat, GL_HALF_FLOAT, 0);
+        uploadBuffer.unbind(GL_PIXEL_UNPACK_BUFFER);
+        uploadedRows += rows;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(data.textureTarget, 0);
+    if(isLoaded()) {
+        vector<uint16_t>().swap(staging);
+        uploadBuffer = ofBufferObject();
+    }
+}
+
+bool MapTexture::isLoaded() const {
+    return height > 0 && uploadedRows == height;
+}
+
+ofTexture& MapTexture::getTexture() {
+    return texture;
+}
+
+int MapTexture::getWidth() const {
+    return width;
+}
+
+int MapTexture::getHeight() const {
+    return height;
+}
+
+size_t MapTexture::getGpuBytes() const {
+    return (size_t) width * height * channels * 2;
+}
+
+// round to nearest with ties up, keeping denormals, infinities and nans
+uint16_t MapTexture::toHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t mantissa = bits & 0x7fffff;
+    int exponent = (bits >> 23) & 0xff;
+    if(exponent == 0xff) {
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    exponent = exponent - 127 + 15;
+    if(exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    if(exponent <= 0) {
+        if(exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        return sign | ((mantissa + (1 << (shift - 1))) >> shift);
+    }
+    // a carry out of the mantissa rounds up into the next exponent, which is right
+    return (sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1);
+}
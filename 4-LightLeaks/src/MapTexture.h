@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ofMain.h"
+
+// a float map kept only on the gpu, as half floats. the pixels are converted
+// in parallel into a staging copy and uploaded a strip of rows at a time, so
+// update() can spread a big map over a few frames, and the cpu side is freed
+// as soon as the last strip is up. strips go through a pixel buffer object, so
+// the copy to the gpu happens while the render thread moves on. maps with
+// fewer than three channels are padded to rgb.
+class MapTexture {
+public:
+    MapTexture();
+    void setup(const ofFloatPixels& pixels, int stripRows = 64);
+    // uploads up to maxStrips strips, 0 uploads everything that is left
+    void update(int maxStrips = 0);
+    bool isLoaded() const;
+
+    ofTexture& getTexture();
+    int getWidth() const;
+    int getHeight() const;
+    size_t getGpuBytes() const;
+
+    static uint16_t toHalf(float value);
+
+protected:
+    ofTexture texture;
+    vector<uint16_t> staging;
+    ofBufferObject uploadBuffer;
+    int width, height, channels;
+    int stripRows, uploadedRows;
+};
@@ -0,0 +1,160 @@
+#include "MultiTracker.h"
+
+#include <chrono>
+
+MultiTracker::MultiTracker()
+:nextId(0)
+,lastMicros(0)
+,maxMicros(0) {
+}
+
+void MultiTracker::clear() {
+    tracks.clear();
+}
+
+void MultiTracker::update(const vector<ofVec2f>& detections, float dt) {
+    auto start = std::chrono::steady_clock::now();
+    int n = MIN(detections.size(), maxTracks);
+
+    // predict
+    for(Track& track : tracks) {
+        track.position += track.velocity * dt;
+    }
+
+    // match, pairs beyond the gate cost more than leaving both unmatched
+    int m = tracks.size();
+    vector<float> cost(m * n);
+    for(int i = 0; i < m; i++) {
+        for(int j = 0; j < n; j++) {
+            float distance = tracks[i].position.distance(detections[j]);
+            cost[i * n + j] = MIN(distance, maxDistance * 2);
+        }
+    }
+    vector<int> assignment = hungarianAssignment(cost, m, n);
+
+    // correct
+    vector<bool> used(n, false);
+    for(int i = 0; i < m; i++) {
+        Track& track = tracks[i];
+        int j = assignment[i];
+        if(j >= 0 && cost[i * n + j] <= maxDistance) {
+            ofVec2f residual = detections[j] - track.position;
+            track.position += alpha * residual;
+            if(dt > 0) {
+                track.velocity += (beta / dt) * residual;
+            }
+            track.hits++;
+            track.missed = 0;
+            used[j] = true;
+        } else {
+            track.missed++;
+        }
+    }
+
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [&](const Track& track) {
+        return track.missed > maxMissed || (track.hits < minHits && track.missed > 0);
+    }), tracks.end());
+
+    for(int j = 0; j < n && tracks.size() < maxTracks; j++) {
+        if(!used[j]) {
+            Track track;
+            track.id = nextId++;
+            track.position = detections[j];
+            track.velocity.set(0, 0);
+            track.hits = 1;
+            track.missed = 0;
+            tracks.push_back(track);
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    lastMicros = std::chrono::duration<float, std::micro>(elapsed).count();
+    maxMicros = MAX(maxMicros, lastMicros);
+}
+
+vector<Track> MultiTracker::getTracks() const {
+    vector<Track> confirmed;
+    for(const Track& track : tracks) {
+        if(track.hits >= minHits) {
+            confirmed.push_back(track);
+        }
+    }
+    return confirmed;
+}
+
+float MultiTracker::getLastMicros() const {
+    return lastMicros;
+}
+
+float MultiTracker::getMaxMicros() const {
+    return maxMicros;
+}
+
+// potentials based O(n^3) version. the matrix is transposed when needed so
+// there are never more rows than columns.
+vector<int> hungarianAssignment(const vector<float>& cost, int rows, int cols) {
+    vector<int> result(rows, -1);
+    if(rows == 0 || cols == 0) {
+        return result;
+    }
+    bool transposed = rows > cols;
+    int n = transposed ? cols : rows;
+    int m = transposed ? rows : cols;
+    auto at = [&](int i, int j) {
+        return transposed ? cost[j * cols + i] : cost[i * cols + j];
+    };
+
+    const float inf = std::numeric_limits<float>::max();
+    vector<float> u(n + 1, 0), v(m + 1, 0), minv(m + 1);
+    vector<int> p(m + 1, 0), way(m + 1, 0);
+    vector<bool> visited(m + 1);
+    for(int i = 1; i <= n; i++) {
+        p[0] = i;
+        int j0 = 0;
+        std::fill(minv.begin(), minv.end(), inf);
+        std::fill(visited.begin(), visited.end(), false);
+        do {
+            visited[j0] = true;
+            int i0 = p[j0], j1 = 0;
+            float delta = inf;
+            for(int j = 1; j <= m; j++) {
+                if(!visited[j]) {
+                    float cur = at(i0 - 1, j - 1) - u[i0] - v[j];
+                    if(cur < minv[j]) {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if(minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+            }
+            for(int j = 0; j <= m; j++) {
+                if(visited[j]) {
+                    u[p[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while(p[j0] != 0);
+        do {
+            int j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while(j0);
+    }
+
+    for(int j = 1; j <= m; j++) {
+        if(p[j] != 0) {
+            if(transposed) {
+                result[j - 1] = p[j] - 1;
+            } else {
+                result[p[j] - 1] = j - 1;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ofMain.h"
+
+struct Track {
+    int id;
+    ofVec2f position, velocity; // in the same units as the detections, velocity per second
+    int hits; // frames with a matching detection
+    int missed; // frames since the last matching detection
+};
+
+// follows several people at once. each track has an alpha-beta filter, detections
+// are matched to the predicted tracks with the hungarian algorithm, and ids stay
+// the same for as long as a track survives. the number of detections is capped
+// at maxTracks so the cost of a frame is bounded no matter how crowded it gets.
+class MultiTracker {
+public:
+    static const int maxTracks = 8;
+
+    MultiTracker();
+    // detections sorted by importance, only the first maxTracks are used
+    void update(const vector<ofVec2f>& detections, float dt);
+    void clear();
+
+    // confirmed tracks, including ones coasting through a short occlusion
+    vector<Track> getTracks() const;
+    float getLastMicros() const;
+    float getMaxMicros() const;
+
+    float alpha = .6; // how much a detection corrects the position
+    float beta = .2; // how much a detection corrects the velocity
+    float maxDistance = 80; // gate, detections further from a prediction start a new track
+    int minHits = 3; // frames before a track is reported
+    int maxMissed = 12; // frames a track coasts before it is dropped
+
+protected:
+    vector<Track> tracks;
+    int nextId;
+    float lastMicros, maxMicros;
+};
+
+// minimum cost assignment for a rows x cols cost matrix stored row-major.
+// returns the column for each row, or -1 if the row is unassigned.
+vector<int> hungarianAssignment(const vector<float>& cost, int rows, int cols);
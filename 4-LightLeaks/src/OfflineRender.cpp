@@ -0,0 +1,187 @@
+#include "OfflineRender.h"
+#include "ofApp.h"
+#include "CpuShader.h"
+#include "AssetLoader.h"
+#include <condition_variable>
+#include <queue>
+
+namespace {
+    string getOption(const vector<string>& args, string name, string fallback) {
+        for(int i = 0; i + 1 < args.size(); i++) {
+            if(args[i] == name) {
+                return args[i + 1];
+            }
+        }
+        return fallback;
+    }
+
+    struct RenderedFrame {
+        string filename;
+        ofPixels pixels;
+    };
+
+    // frames waiting for the writers. send blocks while it is full, so shading
+    // can't run ahead of encoding, and receive only gives up once it is closed
+    // and everything queued has been handed out
+    class FrameQueue {
+    public:
+        FrameQueue(int capacity)
+        :capacity(capacity)
+        ,closed(false) {
+        }
+        void send(RenderedFrame&& frame) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this]() {
+                return (int) frames.size() < capacity;
+            });
+            frames.push(std::move(frame));
+            notEmpty.notify_one();
+        }
+        bool receive(RenderedFrame& frame) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]() {
+                return closed || !frames.empty();
+            });
+            if(frames.empty()) {
+                return false;
+            }
+            frame = std::move(frames.front());
+            frames.pop();
+            notFull.notify_one();
+            return true;
+        }
+        void close() {
+            std::unique_lock<std::mutex> lock(mutex);
+            closed = true;
+            notEmpty.notify_all();
+        }
+
+    protected:
+        std::mutex mutex;
+        std::condition_variable notFull, notEmpty;
+        std::queue<RenderedFrame> frames;
+        int capacity;
+        bool closed;
+    };
+
+    // mean absolute difference in 0-255, or -1 if the sizes don't match
+    float compare(const ofPixels& a, const ofPixels& b) {
+        if(a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight() || a.getNumChannels() != b.getNumChannels()) {
+            return -1;
+        }
+        uint64_t sum = 0;
+        size_t n = a.size();
+        const unsigned char* pa = a.getData();
+        const unsigned char* pb = b.getData();
+        for(size_t i = 0; i < n; i++) {
+            sum += abs(pa[i] - pb[i]);
+        }
+        return n ? (float) sum / n : 0;
+    }
+}
+
+int runOfflineRender(const vector<string>& args) {
+    if(args.empty()) {
+        ofLogError("runOfflineRender") << "missing duration in seconds";
+        return 1;
+    }
+    float duration = ofToFloat(args[0]);
+    float fps = ofToFloat(getOption(args, "--fps", "30"));
+    float startTime = ofToFloat(getOption(args, "--start", "0"));
+    int scale = MAX(1, ofToInt(getOption(args, "--scale", "1")));
+    int forcedStage = ofToInt(getOption(args, "--stage", "-1"));
+    int forcedSubstage = ofToInt(getOption(args, "--substage", "0"));
+    string output = getOption(args, "--output", "render");
+    string reference = getOption(args, "--reference", "");
+    float tolerance = ofToFloat(getOption(args, "--tolerance", "1"));
+
+    AssetLoader loader;
+    std::future<ofFloatPixels> xyzLoad = loader.loadFloat("../../../SharedData/xyzMap.exr");
+    std::future<ofFloatPixels> confidenceLoad = loader.loadFloat("../../../SharedData/confidenceMap.exr");
+    ofFloatPixels xyzMap = xyzLoad.get(), confidenceMap = confidenceLoad.get(), attributes;
+    if(!xyzMap.isAllocated() || !confidenceMap.isAllocated()) {
+        ofLogError("runOfflineRender") << "can't load the xyz and confidence maps from SharedData";
+        return 1;
+    }
+    GeometryAttributes::bake(xyzMap, confidenceMap, lighthouseCenter, minConfidence, attributes);
+    CpuShader shader;
+    shader.setup(xyzMap, attributes, scale);
+
+    // only the state machine, none of setup() runs
+    shared_ptr<ofApp> app(new ofApp);
+    app->debugMode = false;
+    app->setupStage();
+
+    ofDirectory::createDirectory(output, true, true);
+    vector<std::thread> writers;
+    int writerCount = MAX(1, std::thread::hardware_concurrency() / 2);
+    FrameQueue toSave(writerCount * 2);
+    for(int i = 0; i < writerCount; i++) {
+        writers.emplace_back([&toSave]() {
+            RenderedFrame frame;
+            while(toSave.receive(frame)) {
+                ofSaveImage(frame.pixels, frame.filename);
+            }
+        });
+    }
+
+    int frames = duration * fps;
+    int skipped = startTime * fps;
+    int failed = 0;
+    float worstDifference = 0;
+    ofPixels pixels, expected;
+    uint64_t renderMicros = 0;
+    uint64_t start = ofGetElapsedTimeMicros();
+    // every step has to run, however far apart the frames are
+    app->scheduler.setup(1 / app->dt, fps, std::numeric_limits<int>::max());
+    app->advance(0);
+    for(int f = 1; f <= skipped + frames; f++) {
+        // the show before --start runs too, so the state matches a live run
+        float time = f / fps;
+        app->advance(time);
+        if(forcedStage >= 0) {
+            app->stage = app->stageGoal = (Stage) forcedStage;
+            app->substage = forcedSubstage;
+            app->stageAge = 0;
+        }
+        if(f <= skipped) {
+            continue;
+        }
+        int i = f - skipped - 1;
+
+        uint64_t frameStart = ofGetElapsedTimeMicros();
+        shader.render(app->getUniforms(app->scheduler.getTime(), shader.getHeight()), pixels);
+        renderMicros += ofGetElapsedTimeMicros() - frameStart;
+
+        string filename = output + "/frame-" + ofToString(i, 5, '0') + ".png";
+        if(!reference.empty()) {
+            string referenceFile = reference + "/frame-" + ofToString(i, 5, '0') + ".png";
+            float difference = -1;
+            if(ofLoadImage(expected, referenceFile)) {
+                expected.setImageType(OF_IMAGE_GRAYSCALE);
+                difference = compare(pixels, expected);
+            }
+            if(difference < 0 || difference > tolerance) {
+                ofLogWarning("runOfflineRender") << filename << " differs from " << referenceFile << " by " << difference;
+                failed++;
+            }
+            worstDifference = MAX(worstDifference, difference);
+        }
+        toSave.send(RenderedFrame{filename, pixels});
+    }
+    toSave.close();
+    for(std::thread& writer : writers) {
+        writer.join();
+    }
+    float seconds = (ofGetElapsedTimeMicros() - start) / 1e6;
+
+    cout << frames << " frames of " << shader.getWidth() << "x" << shader.getHeight() << " in " << seconds << "s, "
+        << (duration / seconds) << "x realtime, " << (frames ? renderMicros / frames / 1000. : 0) << "ms to shade a frame" << endl;
+    if(!reference.empty()) {
+        cout << "reference: " << failed << " frames over tolerance, worst mean difference " << worstDifference << endl;
+        if(failed > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
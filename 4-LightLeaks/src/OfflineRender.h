@@ -0,0 +1,17 @@
+#pragma once
+
+#include "ofMain.h"
+
+// renders the show without a window or gpu, for previs and for checking shader
+// edits against known good frames:
+//
+// LightLeaks --render <seconds> [--fps 30] [--start 0] [--scale 1]
+//     [--stage n --substage n] [--output render] [--reference dir] [--tolerance 1]
+//
+// the stage state machine runs at its fixed timestep and every frame is shaded
+// by CpuShader over the full map, then saved as output/frame-00000.png on a few
+// writer threads. --stage holds one stage (and substage) for the whole render.
+// with --reference each frame is compared against the same file in dir and the
+// run fails if the mean difference of any frame is over tolerance, in 0-255.
+// ffmpeg -i render/frame-%05d.png makes a video out of it.
+int runOfflineRender(const vector<string>& args);
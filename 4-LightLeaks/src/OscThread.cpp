@@ -0,0 +1,118 @@
+#include "OscThread.h"
+
+OscThread::OscThread()
+:head(0)
+,tail(0)
+,dropped(0)
+,lastBeat(0)
+,minInterval(0) {
+}
+
+void OscThread::setup(string host, int port, int beatPort, float maxRate) {
+    sender.setup(host, port);
+    beatReceiver.setup(beatPort);
+    minInterval = 1 / maxRate;
+}
+
+void OscThread::send(const char* address, std::initializer_list<float> args) {
+    Message message;
+    strncpy(message.address, address, maxAddress - 1);
+    message.address[maxAddress - 1] = 0;
+    message.event = false;
+    message.floatCount = 0;
+    for(float arg : args) {
+        if(message.floatCount < maxArgs) {
+            message.floats[message.floatCount++] = arg;
+        }
+    }
+    message.intArg = 0;
+    push(message);
+}
+
+void OscThread::sendEvent(const char* address, int arg) {
+    Message message;
+    strncpy(message.address, address, maxAddress - 1);
+    message.address[maxAddress - 1] = 0;
+    message.event = true;
+    message.floatCount = 0;
+    message.intArg = arg;
+    push(message);
+}
+
+float OscThread::getLastBeat() const {
+    return lastBeat.load(std::memory_order_acquire);
+}
+
+int OscThread::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+// producer side, the render thread
+bool OscThread::push(const Message& message) {
+    int h = head.load(std::memory_order_relaxed);
+    int next = (h + 1) % ringSize;
+    if(next == tail.load(std::memory_order_acquire)) {
+        dropped++;
+        return false;
+    }
+    ring[h] = message;
+    head.store(next, std::memory_order_release);
+    return true;
+}
+
+// consumer side, this thread
+bool OscThread::pop(Message& message) {
+    int t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    message = ring[t];
+    tail.store((t + 1) % ringSize, std::memory_order_release);
+    return true;
+}
+
+void OscThread::sendNow(const Message& message) {
+    ofxOscMessage msg;
+    msg.setAddress(message.address);
+    for(int i = 0; i < message.floatCount; i++) {
+        msg.addFloatArg(message.floats[i]);
+    }
+    if(message.event) {
+        msg.addIntArg(message.intArg);
+    }
+    sender.sendMessage(msg);
+}
+
+void OscThread::threadedFunction() {
+    Message message;
+    while(isThreadRunning()) {
+        // events go straight out, everything else only keeps the newest value
+        while(pop(message)) {
+            if(message.event) {
+                sendNow(message);
+            } else {
+                Pending& cur = pending[message.address];
+                cur.message = message;
+                cur.dirty = true;
+            }
+        }
+
+        float now = ofGetElapsedTimef();
+        for(auto& it : pending) {
+            Pending& cur = it.second;
+            if(cur.dirty && now - cur.lastSent >= minInterval) {
+                sendNow(cur.message);
+                cur.dirty = false;
+                cur.lastSent = now;
+            }
+        }
+
+        while(beatReceiver.hasWaitingMessages()) {
+            ofxOscMessage msg;
+            beatReceiver.getNextMessage(msg);
+            lastBeat.store(ofGetElapsedTimef(), std::memory_order_release);
+        }
+
+        sleep(1);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include <atomic>
+
+// owns the OSC sockets so the render thread never makes a syscall for audio.
+// the render thread writes preallocated messages into a single producer, single
+// consumer ring buffer. this thread drains it, keeps only the newest value per
+// address and sends each address at most maxRate times per second. events like
+// scene changes skip the coalescing and go out in order. beats received on
+// beatPort come back as a timestamp.
+class OscThread : public ofThread {
+public:
+    static const int maxAddress = 48;
+    static const int maxArgs = 4;
+    static const int ringSize = 256;
+
+    struct Message {
+        char address[maxAddress];
+        bool event;
+        int floatCount;
+        float floats[maxArgs];
+        int intArg;
+    };
+
+    OscThread();
+    void setup(string host, int port, int beatPort, float maxRate);
+
+    // render thread only: the newest values per address are sent at most maxRate per second
+    void send(const char* address, std::initializer_list<float> args);
+    // render thread only: sent as soon as possible, never coalesced
+    void sendEvent(const char* address, int arg);
+
+    // ofGetElapsedTimef() of the most recent beat
+    float getLastBeat() const;
+    int getDropped() const;
+
+protected:
+    void threadedFunction();
+    bool push(const Message& message);
+    bool pop(Message& message);
+    void sendNow(const Message& message);
+
+    Message ring[ringSize];
+    std::atomic<int> head, tail;
+    std::atomic<int> dropped;
+    std::atomic<float> lastBeat;
+
+    // only touched by this thread
+    struct Pending {
+        Message message;
+        bool dirty = false;
+        float lastSent = 0;
+    };
+    map<string, Pending> pending;
+    float minInterval;
+    ofxOscSender sender;
+    ofxOscReceiver beatReceiver;
+};
@@ -0,0 +1,108 @@
+#include "ShowScheduler.h"
+
+ShowScheduler::ShowScheduler()
+:timestep(1. / 120)
+,targetFrameTime(1. / 120)
+,maxStepsPerFrame(8)
+,accumulator(0)
+,lastTime(0)
+,steppedTime(0)
+,started(false)
+,frameTime(0)
+,frames(0)
+,lateFrames(0)
+,missedFrames(0)
+,droppedSteps(0)
+,history(600, 0)
+,historyIndex(0) {
+}
+
+void ShowScheduler::setup(float simulationRate, float targetFrameRate, int maxStepsPerFrame) {
+    timestep = 1 / simulationRate;
+    targetFrameTime = 1 / targetFrameRate;
+    this->maxStepsPerFrame = maxStepsPerFrame;
+    started = false;
+}
+
+void ShowScheduler::reset(double now) {
+    lastTime = now;
+    accumulator = 0;
+    started = true;
+}
+
+int ShowScheduler::update(double now) {
+    if(!started) {
+        reset(now);
+        return 0;
+    }
+    frameTime = now - lastTime;
+    lastTime = now;
+
+    frames++;
+    history[historyIndex] = frameTime;
+    historyIndex = (historyIndex + 1) % history.size();
+    // a little slack so normal timer noise doesn't count as late
+    if(frameTime > targetFrameTime * 1.2) {
+        int intervals = frameTime / targetFrameTime;
+        if(intervals >= 2) {
+            missedFrames += intervals - 1;
+        } else {
+            lateFrames++;
+        }
+    }
+
+    accumulator += frameTime;
+    int steps = accumulator / timestep;
+    if(steps > maxStepsPerFrame) {
+        // don't try to catch up after a stall, that only makes the next frame late too
+        droppedSteps += steps - maxStepsPerFrame;
+        steps = maxStepsPerFrame;
+        accumulator = steps * timestep;
+    }
+    accumulator -= steps * timestep;
+    steppedTime += steps * timestep;
+    return steps;
+}
+
+float ShowScheduler::getTimestep() const {
+    return timestep;
+}
+
+float ShowScheduler::getAlpha() const {
+    return accumulator / timestep;
+}
+
+float ShowScheduler::getFrameTime() const {
+    return frameTime;
+}
+
+double ShowScheduler::getTime() const {
+    return steppedTime + accumulator;
+}
+
+uint64_t ShowScheduler::getFrames() const {
+    return frames;
+}
+
+uint64_t ShowScheduler::getLateFrames() const {
+    return lateFrames;
+}
+
+uint64_t ShowScheduler::getMissedFrames() const {
+    return missedFrames;
+}
+
+uint64_t ShowScheduler::getDroppedSteps() const {
+    return droppedSteps;
+}
+
+float ShowScheduler::getFrameTimePercentile(float p) const {
+    int n = MIN(frames, history.size());
+    if(n == 0) {
+        return 0;
+    }
+    vector<float> recent(history.begin(), history.begin() + n);
+    int i = ofClamp(p * (n - 1), 0, n - 1);
+    std::nth_element(recent.begin(), recent.begin() + i, recent.end());
+    return recent[i];
+}
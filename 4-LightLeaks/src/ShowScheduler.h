@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ofMain.h"
+
+// advances the show at a fixed simulation rate no matter how long frames take.
+// update() is given the current time and returns how many fixed steps to run;
+// the leftover fraction of a step is used to interpolate what gets drawn. the
+// time is passed in rather than read, so tests can drive it with a fake clock.
+// also keeps frame pacing stats against the target render rate.
+class ShowScheduler {
+public:
+    ShowScheduler();
+    void setup(float simulationRate, float targetFrameRate, int maxStepsPerFrame = 8);
+
+    // returns the number of fixed steps to run this frame
+    int update(double now);
+    void reset(double now);
+
+    float getTimestep() const;
+    // how far the current time is between the last two steps, for interpolation
+    float getAlpha() const;
+    // real time since the previous update
+    float getFrameTime() const;
+    // show time for drawing, the steps run so far plus the leftover. unlike the
+    // clock it doesn't jump past the steps dropped after a stall
+    double getTime() const;
+
+    uint64_t getFrames() const;
+    uint64_t getLateFrames() const; // took longer than the target but under two
+    uint64_t getMissedFrames() const; // target intervals that passed without a frame
+    uint64_t getDroppedSteps() const; // steps skipped when a frame took too long to catch up
+    float getFrameTimePercentile(float p) const; // over the recent frames, in seconds
+
+protected:
+    float timestep, targetFrameTime;
+    int maxStepsPerFrame;
+    double accumulator, lastTime, steppedTime;
+    bool started;
+    float frameTime;
+    uint64_t frames, lateFrames, missedFrames, droppedSteps;
+    vector<float> history;
+    int historyIndex;
+};
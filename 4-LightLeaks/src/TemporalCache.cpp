@@ -0,0 +1,66 @@
+#include "TemporalCache.h"
+
+TemporalCache::TemporalCache()
+:valid(false)
+,frame(0)
+,interleave(1)
+,refreshed(1) {
+}
+
+void TemporalCache::setup(int width, int height) {
+    fbo.allocate(width, height, GL_RGBA);
+    invalidate();
+}
+
+void TemporalCache::invalidate() {
+    valid = false;
+}
+
+void TemporalCache::begin(float changePerFrame) {
+    if(fbo.getWidth() != ofGetWidth() || fbo.getHeight() != ofGetHeight()) {
+        setup(ofGetWidth(), ofGetHeight());
+    }
+    if(!enabled || !valid) {
+        interleave = 1;
+    } else if(changePerFrame <= 0) {
+        interleave = maxInterleave;
+    } else {
+        interleave = ofClamp(floorf(maxError / changePerFrame), 1, maxInterleave);
+        // only 1, 2 and 4 split the phases evenly
+        if(interleave == 3) {
+            interleave = 2;
+        }
+    }
+    frame++;
+    refreshed = ofLerp(refreshed, 1. / interleave, .1);
+
+    fbo.begin();
+    if(interleave == 1) {
+        ofClear(0, 255);
+    }
+}
+
+bool TemporalCache::isDue(int phase) const {
+    switch(interleave) {
+        case 2: return (phase == 0 || phase == 3) == (frame % 2 == 0); // checkerboard
+        case 4: return phase == frame % 4;
+        default: return true;
+    }
+}
+
+void TemporalCache::end() {
+    fbo.end();
+    valid = true;
+}
+
+void TemporalCache::draw(float x, float y, float w, float h) {
+    fbo.draw(x, y, w, h);
+}
+
+int TemporalCache::getInterleave() const {
+    return interleave;
+}
+
+float TemporalCache::getRefreshed() const {
+    return refreshed;
+}
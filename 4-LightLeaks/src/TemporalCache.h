@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ofMain.h"
+
+// keeps the last rendered frame in an fbo and only redraws part of it when the
+// image changes slowly. tiles are split into four interleaved phases: every frame
+// (interleave 1), checkerboard halves on alternating frames (interleave 2), or one
+// phase per frame (interleave 4). the interleave is chosen so a tile that waits
+// its turn is never further than maxError from what a full render would show.
+class TemporalCache {
+public:
+    TemporalCache();
+    void setup(int width, int height);
+    // forces a full redraw on the next frame, for stage changes
+    void invalidate();
+
+    // changePerFrame is the largest brightness change any pixel can see this frame
+    void begin(float changePerFrame);
+    // whether tiles of this phase (0 to 3) need drawing between begin() and end()
+    bool isDue(int phase) const;
+    void end();
+    void draw(float x, float y, float w, float h);
+
+    int getInterleave() const;
+    // fraction of tiles redrawn, averaged over recent frames
+    float getRefreshed() const;
+
+    bool enabled = false;
+    float maxError = .05; // quality / performance knob, in brightness units
+    int maxInterleave = 4;
+
+protected:
+    ofFbo fbo;
+    bool valid;
+    int frame;
+    int interleave;
+    float refreshed;
+};
@@ -0,0 +1,169 @@
+#include "TrackerBenchmark.h"
+#include "AudienceTracker.h"
+#include <numeric>
+
+namespace {
+    string getOption(const vector<string>& args, string name, string fallback) {
+        for(int i = 0; i + 1 < args.size(); i++) {
+            if(args[i] == name) {
+                return args[i + 1];
+            }
+        }
+        return fallback;
+    }
+
+    bool hasFlag(const vector<string>& args, string name) {
+        return std::find(args.begin(), args.end(), name) != args.end();
+    }
+
+    // frame -> id -> position
+    map<uint64_t, map<int, ofVec2f>> loadTracks(string filename) {
+        map<uint64_t, map<int, ofVec2f>> tracks;
+        ofBuffer buffer = ofBufferFromFile(filename);
+        bool header = true;
+        for(auto& line : buffer.getLines()) {
+            if(header) {
+                header = false;
+                continue;
+            }
+            vector<string> cols = ofSplitString(line, ",");
+            if(cols.size() < 5) {
+                continue;
+            }
+            uint64_t frame = ofToInt64(cols[0]);
+            map<int, ofVec2f>& cur = tracks[frame];
+            for(int i = 5; i + 2 < cols.size(); i += 3) {
+                cur[ofToInt(cols[i])] = ofVec2f(ofToFloat(cols[i + 1]), ofToFloat(cols[i + 2]));
+            }
+        }
+        return tracks;
+    }
+
+    float percentile(vector<float> values, float p) {
+        if(values.empty()) {
+            return 0;
+        }
+        int i = ofClamp(p * (values.size() - 1), 0, values.size() - 1);
+        std::nth_element(values.begin(), values.begin() + i, values.end());
+        return values[i];
+    }
+}
+
+int runTrackerBenchmark(const vector<string>& args) {
+    if(args.empty()) {
+        ofLogError("runTrackerBenchmark") << "missing frame source";
+        return 1;
+    }
+    string type = args[0];
+    string path = args.size() > 1 && args[1].substr(0, 2) != "--" ? args[1] : "";
+    bool realtime = hasFlag(args, "--realtime");
+    string output = getOption(args, "--output", "trackerBenchmark.csv");
+    string reference = getOption(args, "--reference", "");
+    float tolerance = ofToFloat(getOption(args, "--tolerance", "1"));
+    int maxFrames = ofToInt(getOption(args, "--frames", "0"));
+
+    shared_ptr<FrameSource> source = createFrameSource(type, path, realtime);
+    if(!source) {
+        return 1;
+    }
+    SyntheticSource* synthetic = dynamic_cast<SyntheticSource*>(source.get());
+
+    AudienceTracker tracker;
+    tracker.setup(source, false, "");
+
+    ofFile out(output, ofFile::WriteOnly);
+    out << "frame,processMicros,trackMicros,latencyMs,trackCount,id,x,y..." << endl;
+
+    vector<float> processMicros, trackMicros, latency;
+    vector<ofVec2f> errors;
+    uint64_t start = ofGetElapsedTimeMicros();
+    TrackerResult result;
+    while(!source->isFinished() && (maxFrames == 0 || processMicros.size() < maxFrames)) {
+        if(!tracker.step()) {
+            if(realtime) {
+                ofSleepMillis(1);
+            }
+            continue;
+        }
+        if(!tracker.getLatest(result)) {
+            continue;
+        }
+        processMicros.push_back(result.processMicros);
+        trackMicros.push_back(result.trackMicros);
+        latency.push_back((result.publishTime - result.arrivalTime) * 1000);
+        out << result.frame << "," << result.processMicros << "," << result.trackMicros << ","
+            << latency.back() << "," << result.trackCount;
+        for(int i = 0; i < result.trackCount; i++) {
+            const Track& track = result.tracks[i];
+            out << "," << track.id << "," << track.position.x << "," << track.position.y;
+        }
+        out << endl;
+
+        // distance from each visitor to the closest track
+        if(synthetic && result.trackCount > 0) {
+            for(const ofVec2f& truth : synthetic->getTruth()) {
+                ofVec2f best;
+                float bestDistance = std::numeric_limits<float>::max();
+                for(int i = 0; i < result.trackCount; i++) {
+                    float distance = truth.distance(result.tracks[i].position);
+                    if(distance < bestDistance) {
+                        bestDistance = distance;
+                        best = result.tracks[i].position - truth;
+                    }
+                }
+                errors.push_back(best);
+            }
+        }
+    }
+    float seconds = (ofGetElapsedTimeMicros() - start) / 1e6;
+    out.close();
+    tracker.close();
+
+    int frames = processMicros.size();
+    cout << frames << " frames in " << seconds << "s, " << (frames / seconds) << " fps" << endl;
+    cout << "process us: mean " << (frames ? std::accumulate(processMicros.begin(), processMicros.end(), 0.f) / frames : 0)
+        << " p99 " << percentile(processMicros, .99) << " max " << percentile(processMicros, 1) << endl;
+    cout << "track us: p99 " << percentile(trackMicros, .99) << " max " << percentile(trackMicros, 1) << endl;
+    cout << "latency ms: median " << percentile(latency, .5) << " p99 " << percentile(latency, .99) << endl;
+
+    // the blur and dilation grow every box by the same amount, so report that
+    // offset separately from the jitter around it
+    if(!errors.empty()) {
+        ofVec2f bias;
+        for(const ofVec2f& error : errors) {
+            bias += error;
+        }
+        bias /= errors.size();
+        double jitter = 0;
+        for(const ofVec2f& error : errors) {
+            jitter += (error - bias).lengthSquared();
+        }
+        jitter = sqrt(jitter / errors.size());
+        cout << "synthetic: offset " << bias << " rms jitter " << jitter << "px" << endl;
+    }
+
+    if(!reference.empty()) {
+        auto expected = loadTracks(reference);
+        auto actual = loadTracks(output);
+        float maxDeviation = 0;
+        int mismatched = 0;
+        for(auto& frame : expected) {
+            map<int, ofVec2f>& cur = actual[frame.first];
+            if(cur.size() != frame.second.size()) {
+                mismatched++;
+            }
+            for(auto& track : frame.second) {
+                auto found = cur.find(track.first);
+                if(found == cur.end()) {
+                    continue;
+                }
+                maxDeviation = MAX(maxDeviation, found->second.distance(track.second));
+            }
+        }
+        cout << "reference: " << mismatched << " frames with different tracks, max deviation " << maxDeviation << "px" << endl;
+        if(mismatched > 0 || maxDeviation > tolerance) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ofMain.h"
+
+// runs the audience tracker without a window over a recorded or synthetic source:
+//
+// LightLeaks --benchmark-tracker <synthetic|video|images> [path] [--realtime]
+//     [--frames n] [--output tracks.csv] [--reference tracks.csv] [--tolerance 1]
+//
+// writes one line per frame with timings and track positions, prints throughput
+// and latency, and with --reference fails if any track moved further than
+// tolerance pixels from the reference run.
+int runTrackerBenchmark(const vector<string>& args);
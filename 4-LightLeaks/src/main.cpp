@@ -1,106 +1,94 @@
 #include "ofApp.h"
+#include "TrackerBenchmark.h"
+#include "OfflineRender.h"
+
+// every projector after the first gets a window that only draws its part of the
+// map, the show itself runs once in the main app
+class OutputApp : public ofBaseApp {
+public:
+    int id;
+    shared_ptr<ofApp> mainApp;
+
+    void config(int id, shared_ptr<ofApp> mainApp) {
+        this->id = id;
+        this->mainApp = mainApp;
+    }
+    void setup() {
+        ofBackground(0);
+        ofSetVerticalSync(false);
+    }
+    void draw() {
+        mainApp->drawOutput(id);
+    }
+    void keyPressed(int key) {
+        mainApp->keyPressed(key);
+    }
+    void exit() {
+        mainApp->releaseOutput(id);
+    }
+};
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    if(args.size() > 0 && args[0] == "--benchmark-tracker") {
+        ofInit();
+        return runTrackerBenchmark(vector<string>(args.begin() + 1, args.end()));
+    }
+    if(args.size() > 0 && args[0] == "--render") {
+        ofInit();
+        return runOfflineRender(vector<string>(args.begin() + 1, args.end()));
+    }
+
+    ofJson jsonconfig = ofLoadJson("../../../SharedData/settings.json");
+    ofJson projectors = jsonconfig["projectors"];
 
-int main() {
-    
     shared_ptr<ofApp> mainApp(new ofApp);
 
-    vector< shared_ptr<ofAppBaseWindow> > windows;
-    
-//    int numWindows = 1;
-    /*for(int i=0;i<numWindows;i++){
-     
-        ofGLFWWindowSettings settings;
-        settings.width = 600;
-        settings.height = 600;
-        settings.setPosition(ofVec2f(1920*i+100,0));
-        settings.resizable = true;
-        if(i > 0){
-            settings.shareContextWith = ofGetMainLoop()->getCurrentWindow();
+    ofGLFWWindowSettings settings;
+    settings.resizable = false;
+    settings.decorated = false;
+
+    if(projectors.size() == 0) {
+        // one window spanning all the projectors, the map is drawn whole
+        settings.width = 4*1920;
+        settings.height = 1080;
+        settings.setPosition(ofVec2f(-1920*4,0));
+        shared_ptr<ofAppBaseWindow> win = ofCreateWindow(settings);
+        win->setVerticalSync(false);
+        win->setWindowTitle("Projector 1");
+        ofRunApp(win, mainApp);
+        ofRunMainLoop();
+        return 0;
+    }
+
+    // one window per projector, all sharing the first window's context
+    shared_ptr<ofAppBaseWindow> mainWindow;
+    for(int i = 0; i < projectors.size(); i++) {
+        ofJson curConfig = projectors[i];
+        settings.monitor = curConfig["monitor"];
+        settings.width = curConfig["width"];
+        settings.height = curConfig["height"];
+        settings.setPosition(ofVec2f(curConfig["xwindow"], curConfig["ywindow"]));
+        if(mainWindow) {
+            settings.shareContextWith = mainWindow;
         }
 
         shared_ptr<ofAppBaseWindow> win = ofCreateWindow(settings);
-        
         win->setVerticalSync(false);
-        win->setFullscreen(true);
-        windows.push_back(win);
-        //win.setMultiDisplayFullscreen(true); //this makes the fullscreen window span across all your monitors
-        
-        ofRunApp(windows[i], mainApp);
+        win->setWindowTitle("Projector " + ofToString(i + 1));
 
-    }*/
-    
-    
-    ofGLFWWindowSettings settings;
-    settings.width = 4*1920;
-    settings.height = 1080;
-    settings.setPosition(ofVec2f(-1920*4,0)); // uncomment this!
-    settings.resizable = false;
-    settings.decorated = false;
-//    settings.monitor = 0;
-    
-    shared_ptr<ofAppBaseWindow> win = ofCreateWindow(settings);
-    win->setVerticalSync(false);
-    win->setWindowTitle("Projector 1");
-    windows.push_back(win);
-//
-//
-//    
-//    settings.width = 600;
-//    settings.height = 600;
-//    settings.setPosition(ofVec2f(1920,0));
-//    settings.resizable = false;
-//    settings.shareContextWith = ofGetMainLoop()->getCurrentWindow();
-//    
-//    shared_ptr<ofAppBaseWindow> win2 = ofCreateWindow(settings);
-//    win2->setWindowTitle("Projector 2");
-//    win2->setVerticalSync(false);
-//    windows.push_back(win2);
-//    
-//    
-//    settings.width = 600;
-//    settings.height = 600;
-//    settings.setPosition(ofVec2f(1920*2,0));
-//    settings.resizable = false;
-//    settings.shareContextWith = ofGetMainLoop()->getCurrentWindow();
-//    
-//    shared_ptr<ofAppBaseWindow> win3 = ofCreateWindow(settings);
-//    win3->setWindowTitle("Projector 3");
-//    win3->setVerticalSync(false);
-//    windows.push_back(win3);
-//    
-//    settings.width = 600;
-//    settings.height = 600;
-//    settings.setPosition(ofVec2f(1920*3,0));
-//    settings.resizable = false;
-//    settings.shareContextWith = ofGetMainLoop()->getCurrentWindow();
-//    
-//    shared_ptr<ofAppBaseWindow> win4 = ofCreateWindow(settings);
-//    win4->setWindowTitle("Projector 4");
-//    win4->setVerticalSync(false);
-//    windows.push_back(win4);
-    
-  /*
-    win->setWindowPosition(1920, 0);
-    win->setWindowShape(1920,  1200);
-    
-    win2->setWindowPosition(1920, 0);
+        // xcode and ycode are where this projector starts in the map
+        float xcode = curConfig["xcode"], ycode = curConfig["ycode"];
+        mainApp->addOutput(ofRectangle(xcode, ycode, settings.width, settings.height));
+        if(i == 0) {
+            mainWindow = win;
+            ofRunApp(win, mainApp);
+        } else {
+            shared_ptr<OutputApp> outputApp(new OutputApp);
+            outputApp->config(i, mainApp);
+            ofRunApp(win, outputApp);
+        }
+    }
 
-    */
-    mainApp->windows = windows;
-//
-    ofRunApp(windows[0], mainApp);
-//    ofRunApp(windows[1], mainApp);
-//    ofRunApp(windows[2], mainApp);
-//    ofRunApp(windows[3], mainApp);
-//
     ofRunMainLoop();
-    
-//    ofGLFWWindowSettings win;
-//    
-//    win.width = 1920*4;
-//    win.height = 1080;
-//    win.multiMonitorFullScreen = true;
-//    
-//    ofCreateWindow(win)->setFullscreen(true);
-//    ofRunApp(new ofApp());
 }
@@ -1,15 +1,12 @@
 #include "ofApp.h"
 
-const float trackScale = .25; // actual resizing on the image data
 const float previewScale = .25; // presentation on the screen for calibration
 const ofVec2f previewOffset(440, 248); // placement of debug image for calibration
-const float backgroundLearningTime = 4; // in frames
-const int foregroundBlur = 15; // after scaling by trackScale
-const int foregroundDilate = 5; // connect disconnected parts. will fail to separate a big group of people.
-const float contourFinderThreshold = 32; // higher blur calls for lower threshold
-const float minAreaRadius = 5; // after scaling by trackScale
-const float maxAreaRadius = 80; // after scaling by trackScale
 const float lighthouseSpeed = 3;
+const float oscMaxRate = 60; // per address, in messages per second
+const float simulationRate = 120; // fixed steps per second for the stages, independent of the render rate
+const float targetFrameRate = 120;
+const int mapStripsPerFrame = 8; // of 64 rows each, while the maps are uploading
 
 const float durationIntermezzo = 30;
 const float intervalIntermezzo = 30;
@@ -42,13 +39,13 @@ string getStageName(int stage) {
 
 void ofApp::setup() {
     if(!setupCalled){
-        oscSender.setup("localhost", 7777);
-        oscBeat.setup(9090);
+        osc.setup("localhost", 7777, 9090, oscMaxRate);
+        osc.startThread();
 
         setupCalled = true;
         ofSetLogLevel(OF_LOG_VERBOSE);
         ofSetVerticalSync(false);
-        ofSetFrameRate(120);
+        ofSetFrameRate(targetFrameRate);
         ofEnableAlphaBlending();
         
         //ofSetWindowPosition(1680,0);
@@ -63,62 +60,81 @@ void ofApp::setup() {
 //            ofSetFullscreen(true);
         }
         
-        previousTime = 0;
+        setupStage();
         
-        //Shader
-        shader.load("shader");
-        
-        xyzMap.load("../../../SharedData/xyzMap.exr");
-//        normalMap.load("../../../SharedData/normalMap.exr");
-        confidenceMap.load("../../../SharedData/confidenceMap.exr");
-        
-        xyzMap.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-//        normalMap.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-        confidenceMap.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-        
-        stage = Lighthouse;
-        substage = 0;
-        
-        //Spotlight setup
-        spotlightPosition.setFc(0.01); //Low pass biquad filter - allow only slow frequencies
+        {
+            // both maps decode side by side while the shader compiles. the float maps
+            // only live until the end of this block, the gpu gets half floats and
+            // confidence only goes up baked into the attributes
+            uint64_t loadStart = ofGetElapsedTimeMicros();
+            AssetLoader loader;
+            std::future<ofFloatPixels> xyzLoad = loader.loadFloat("../../../SharedData/xyzMap.exr");
+            std::future<ofFloatPixels> confidenceLoad = loader.loadFloat("../../../SharedData/confidenceMap.exr");
+            
+            //Shader
+            shader.load("shader");
+            
+            ofFloatPixels xyzPixels = xyzLoad.get();
+            xyzMap.setup(xyzPixels);
+            ofFloatPixels confidencePixels = confidenceLoad.get();
+            attributes.setup(xyzPixels, confidencePixels, lighthouseCenter, minConfidence);
+            ofLogNotice("setup") << "loaded maps in " << (ofGetElapsedTimeMicros() - loadStart) / 1000 << "ms\n" << loader.getReport()
+                << "map textures use " << (xyzMap.getGpuBytes() + attributes.getGpuBytes()) / (1024 * 1024) << "MB";
+        }
+        drawMode = GeometryAttributes::DRAW_TILES;
+        useAttributes = true;
+        // at .1 the concentric spheres interleave 2 or 4 for most of their cycle
+        cacheEnabled = config.exists("cache/enabled") && config.getBoolValue("cache/enabled");
+        cacheMaxError = config.exists("cache/maxError") ? ofToFloat(config.getValue("cache/maxError")) : .1;
+        if(outputs.empty()) {
+            // no projectors configured, one window shows the whole map
+            addOutput(ofRectangle(0, 0, xyzMap.getWidth(), xyzMap.getHeight()));
+        }
         
 //        kl.load("kl.jpg");
         
         setupSpeakers();
+        setupExport();
 #ifdef USE_CAMERA
         photoCounter = 0;
         setupTracker();
 #endif
         
     }
-    
-    int numWindows = 1;
-//    int numWindows = windows.size();
-//    int curWindow = -1;
-//    for(int i=0;i<numWindows;i++){
-//        if(ofGetWindowPtr() == windows[i].get()){
-//            curWindow = i;
-//        }
-//    }
-    
-//    if(curWindow == 0){
-//        
-//     //   dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-//            ofSetWindowPosition(0, 0);
-//            ofSetWindowShape(1920, 1200);
-//            
-//     
-//     //   });
-//    }
-//    if(curWindow == 1){
-////        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-//            ofSetWindowPosition(1920, 0);
-//            ofSetWindowShape(1920*2,  1200);
-//            
-//      //  });
-//    }
+}
 
-    
+// everything the stage state machine needs, without any gl. the offline renderer
+// runs the show with only this.
+void ofApp::setupStage() {
+    scheduler.setup(simulationRate, targetFrameRate);
+    dt = scheduler.getTimestep();
+    
+    stage = Lighthouse;
+    stageGoal = Lighthouse;
+    substage = 0;
+    stageAge = 0;
+    previousStage = stage;
+    previousSubstage = substage;
+    previousSpheresOffset = 0;
+    lighthouseAngle = 0;
+    stageAmp = 0;
+    lastStageAmp = renderStageAmp = stageAmp;
+    lastLighthouseAngle = renderLighthouseAngle = lighthouseAngle;
+    frameChange = 1;
+    
+    //Spotlight setup
+    spotlightPosition.setFc(0.01); //Low pass biquad filter - allow only slow frequencies
+    spotlightThresholder = 0;
+    spotlightCount = 0;
+    for(int i = 0; i < maxSpotlights; i++) {
+        spotlights[i].set(0, 0, 0);
+        spotlightIds[i] = -1;
+    }
+#ifdef USE_CAMERA
+    trackerResult = TrackerResult();
+    // only setupTracker turns it on, the offline renderer never calls it
+    trackerEnabled = false;
+#endif
 }
 
 void ofApp::setupSpeakers() {
@@ -155,39 +171,42 @@ void ofApp::update() {
         shader.load("shader");
     }
     
-    int numWindows = 1;
+    // the maps go up a few strips per frame after startup
+    if(!mapsLoaded()) {
+        xyzMap.update(mapStripsPerFrame);
+        attributes.update(mapStripsPerFrame);
+        if(mapsLoaded()) {
+            for(auto& output : outputs) {
+                output->cache.invalidate();
+            }
+        }
+    }
     
-//    int numWindows = windows.size();
-//    int curWindow = -1;
-//    for(int i=0;i<numWindows;i++){
-//        if(ofGetWindowPtr() == windows[i].get()){
-//            curWindow = i;
-//        }
-//    }
+    advance(ofGetElapsedTimef());
     
-//    if(curWindow == 0){
-//        
-//        //   dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-//        ofSetWindowPosition(0, 0);
-//        ofSetWindowShape(1920, 1200);
-//        
-//        
-//        //   });
-//    }
-//    if(curWindow == 1){
-//        //        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-//        ofSetWindowPosition(0+1920, 0);
-//        ofSetWindowShape(1920,  1200);
-//        
-//        //  });
-//    }
+    updateOsc();
+}
 
-    
-    float currentTime = ofGetElapsedTimef();
-    dt = currentTime - previousTime;
-    dt = ofClamp(dt, 0, .1);
-    previousTime = currentTime;
-    
+bool ofApp::mapsLoaded() const {
+    return xyzMap.isLoaded() && attributes.isLoaded();
+}
+
+// runs however many fixed steps fit up to now, and interpolates what gets drawn
+void ofApp::advance(double now) {
+    int steps = scheduler.update(now);
+    for(int i = 0; i < steps; i++) {
+        lastStageAmp = stageAmp;
+        lastLighthouseAngle = lighthouseAngle;
+        updateStage();
+    }
+    float alpha = scheduler.getAlpha();
+    renderStageAmp = ofLerp(lastStageAmp, stageAmp, alpha);
+    renderLighthouseAngle = ofLerp(lastLighthouseAngle, lighthouseAngle, alpha);
+    frameChange = estimateFrameChange();
+}
+
+// one fixed step of the stage state machine, dt is always the same
+void ofApp::updateStage() {
     stageAge += dt;
     
     if(debugMode){
@@ -271,8 +290,7 @@ void ofApp::update() {
             if(stage == Spotlight) {
                 photoCounter = (photoCounter + 1) % photoFrequency;
                 if(photoCounter == 0) {
-                    ofDirectory::createDirectory("photos", true, true)	;
-                    ofSaveImage(grabber.getColorPixels(), "photos/" + ofGetTimestampString() + ".jpg", OF_IMAGE_QUALITY_MEDIUM);
+                    tracker.requestPhoto();
                 }
             }
 #endif
@@ -286,106 +304,195 @@ void ofApp::update() {
 #ifdef USE_CAMERA
     updateTracker();
 #endif
-    updateOsc();
 }
 
+// only queues messages, OscThread does the sending
 void ofApp::updateOsc() {
-    while(oscBeat.hasWaitingMessages()) {
-        ofxOscMessage msg;
-        oscBeat.getNextMessage(msg);
-        lastBeat = ofGetElapsedTimef();
-        cout << "got beat" << endl;
-    }
-    
     if(stage == Lighthouse) {
-        ofxOscMessage msg;
-        msg.setAddress("/audio/lighthouse_angle");
-        msg.addFloatArg(fmodf(lighthouseAngle/TWO_PI, 1));
-        oscSender.sendMessage(msg);
+        osc.send("/audio/lighthouse_angle", {fmodf(lighthouseAngle/TWO_PI, 1)});
     }
     
     if(stage == Spotlight) {
-        ofxOscMessage msg;
-        msg.setAddress("/audio/spotlight_position");
         float x = spotlightPosition.value().x;
         float y = spotlightPosition.value().y;
         x = ofMap(x, 0, 1, -1, 1);
         y = ofMap(y, .5, 0, -1, 1);
-        msg.addFloatArg(y); // between Rs and R
-        msg.addFloatArg(x); // between Ls and L
-        oscSender.sendMessage(msg);
+        osc.send("/audio/spotlight_position", {
+            y, // between Rs and R
+            x // between Ls and L
+        });
+        
+        // one address per slot so the coalescing in OscThread stays bounded
+        osc.send("/audio/spotlight_count", {(float) spotlightCount});
+        for(int i = 0; i < maxSpotlights; i++) {
+            char address[32];
+            snprintf(address, sizeof(address), "/audio/spotlight_track/%d", i);
+            if(i < spotlightCount) {
+                osc.send(address, {
+                    (float) spotlightIds[i],
+                    ofMap(spotlights[i].y, .5, 0, -1, 1),
+                    ofMap(spotlights[i].z, 0, 1, -1, 1),
+                    1});
+            } else {
+                osc.send(address, {-1, 0, 0, 0});
+            }
+        }
     }
 }
 
 
 
-void ofApp::draw() {
-    int numWindows = 1;
-//    int numWindows = windows.size();
-//    int curWindow = 0;
-//    for(int i=0;i<numWindows;i++){
-//        if(ofGetWindowPtr() == windows[i].get()){
-//            curWindow = i;
-//        }
-//    }
+void ofApp::addOutput(ofRectangle region) {
+    shared_ptr<Output> output(new Output);
+    output->region = region;
+    outputs.push_back(output);
+}
+
+// what shader.frag needs this frame, shared with the cpu shader
+ShowUniforms ofApp::getUniforms(float time, float windowHeight) {
+    ShowUniforms uniforms;
+    uniforms.elapsedTime = time;
+    uniforms.beamAngle = fmodf(renderLighthouseAngle, TWO_PI);
+    //Lighthouse parameters
+    uniforms.beamWidth = 0;
+    if(stage == Lighthouse){
+        // lighthouse is small most of the time, comes and goes from 0
+        uniforms.beamWidth = ofMap(cubicEaseInOut(renderStageAmp), 0, 1, 0, .3);
+    }
+    uniforms.spotlightSize = 0.2 * cubicEaseInOut(renderStageAmp);
+    // convert where x is the long side of the room, y is short
+    // into the model's coordinates where z is the long side, y is short
+    uniforms.spotlightPos.set(0,
+                              spotlightPosition.value().y,
+                              spotlightPosition.value().x);
+    for(int i = 0; i < maxSpotlights; i++) {
+        uniforms.spotlights[i] = spotlights[i];
+    }
+    uniforms.spotlightCount = spotlightCount;
+    uniforms.stage = stage;
+    uniforms.substage = substage;
+    uniforms.stageAmp = renderStageAmp;
+    uniforms.mouse.set((float)mouseX/1920, (float)mouseY/windowHeight);
+    return uniforms;
+}
+
+// draws one projector's part of the map, scaled to fill the current window.
+// the windows share one context, so the shader, maps and meshes only exist once.
+// nothing here reads back from the gpu, so no output waits on another one.
+void ofApp::drawOutput(int i) {
+    Output& output = *outputs[i];
+    uint64_t start = ofGetElapsedTimeMicros();
+    if(output.lastDraw > 0) {
+        output.frameInterval = (start - output.lastDraw) / 1e6;
+    }
+    output.lastDraw = start;
     
     ofBackground(0);
     ofEnableAlphaBlending();
     ofSetColor(255);
     
-    //Lighthouse parameters
-    float beamWidth = 0;
-    if(stage == Lighthouse){
-        // lighthouse is small most of the time, comes and goes from 0
-        beamWidth = ofMap(cubicEaseInOut(stageAmp), 0, 1, 0, .3);
+    // where the whole map lands in this window
+    float sx = ofGetWidth() / output.region.width;
+    float sy = ofGetHeight() / output.region.height;
+    float mapX = -output.region.x * sx, mapY = -output.region.y * sy;
+    float mapWidth = xyzMap.getWidth() * sx, mapHeight = xyzMap.getHeight() * sy;
+    
+    TemporalCache& cache = output.cache;
+    cache.enabled = cacheEnabled;
+    cache.maxError = cacheMaxError;
+    if(cacheEnabled) {
+        cache.begin(frameChange);
     }
-    float spotlightSize = 0.2 * cubicEaseInOut(stageAmp);
-    
+    ShowUniforms uniforms = getUniforms(scheduler.getTime(), ofGetHeight());
     shader.begin(); {
-        shader.setUniform1f("elapsedTime", ofGetElapsedTimef());
-        shader.setUniform1f("beamAngle", fmodf(lighthouseAngle, TWO_PI));
-        shader.setUniform1f("beamWidth", beamWidth);
-        // convert where x is the long side of the room, y is short
-        // into the model's coordinates where z is the long side, y is short
-        shader.setUniform3f("spotlightPos",
-                            0,
-                            spotlightPosition.value().y,
-                            spotlightPosition.value().x);
-        shader.setUniform1f("spotlightSize", spotlightSize);
-        shader.setUniform1i("stage", stage);
-        shader.setUniform1i("substage", substage);
-        shader.setUniform1f("stageAmp", stageAmp);
-        shader.setUniform2f("mouse", ofVec2f((float)mouseX/1920, (float)mouseY/ofGetHeight()));
-        shader.setUniformTexture("xyzMap", xyzMap, 0);
-        //shader.setUniformTexture("normalMap", normalMap, 2);
-        shader.setUniformTexture("confidenceMap", confidenceMap, 3);
+        shader.setUniform1f("elapsedTime", uniforms.elapsedTime);
+        shader.setUniform1f("beamAngle", uniforms.beamAngle);
+        shader.setUniform1f("beamWidth", uniforms.beamWidth);
+        shader.setUniform3f("spotlightPos", uniforms.spotlightPos);
+        shader.setUniform3fv("spotlights", &uniforms.spotlights[0].x, maxSpotlights);
+        shader.setUniform1i("spotlightCount", uniforms.spotlightCount);
+        shader.setUniform1f("spotlightSize", uniforms.spotlightSize);
+        shader.setUniform1i("stage", uniforms.stage);
+        shader.setUniform1i("substage", uniforms.substage);
+        shader.setUniform1f("stageAmp", uniforms.stageAmp);
+        shader.setUniform2f("mouse", uniforms.mouse);
+        shader.setUniformTexture("xyzMap", xyzMap.getTexture(), 0);
+        shader.setUniformTexture("attributeMap", attributes.getTexture(), 5);
+        shader.setUniform1i("useAttributes", useAttributes);
 //        shader.setUniformTexture("kl", kl, 4);
         shader.setUniform1i("useConfidence", 1);
         
         float curTime = ofGetElapsedTimef();
-        float timeSinceBeat = curTime - lastBeat;
+        float timeSinceBeat = curTime - osc.getLastBeat();
         shader.setUniform1f("timeSinceBeat", timeSinceBeat);
         
-        // DRaw all projectors in one window
-        xyzMap.draw(0, 0, ofGetWidth(), ofGetHeight());
-        
-        // Draw 1 projector per window
-//        xyzMap.drawSubsection(0, 0, ofGetWidth(), ofGetHeight(),curWindow * xyzMap.getWidth()/numWindows,0,xyzMap.getWidth()/numWindows, xyzMap.getHeight());
-        
-        // Special: Draw 1 projector in window 1, 2 projectors in window 2
-//        xyzMap.drawSubsection(0, 0, ofGetWidth(), ofGetHeight(),curWindow * xyzMap.getWidth()/2,0,ofGetWidth(), xyzMap.getHeight());
+        // only the calibrated pixels, ofBackground already cleared the rest to black
+        output.shadedPixels.begin();
+        if(!mapsLoaded()) {
+            // still uploading, stay black
+        } else if(cacheEnabled) {
+            for(int phase = 0; phase < 4; phase++) {
+                if(cache.isDue(phase)) {
+                    attributes.drawTilePhase(mapX, mapY, mapWidth, mapHeight, phase);
+                }
+            }
+        } else {
+            attributes.drawValid(mapX, mapY, mapWidth, mapHeight, drawMode);
+        }
+        output.shadedPixels.end();
     } shader.end();
+    if(cacheEnabled) {
+        cache.end();
+        cache.draw(0, 0, ofGetWidth(), ofGetHeight());
+    }
+    output.drawMicros = ofGetElapsedTimeMicros() - start;
     
+    if(debugMode){
+        ofSetColor(255);
+        const char* drawModes[] = {"tiles", "runs", "full"};
+        float shadedPercent = 100. * output.shadedPixels.getPixels() / (ofGetWidth() * ofGetHeight());
+        ofDrawBitmapStringHighlight(string(drawModes[drawMode]) + (useAttributes ? "" : " unbaked") + " shaded " + ofToString(output.shadedPixels.getPixels()) +
+                                    "px (" + ofToString(shadedPercent, 1) + "%)", 5, ofGetHeight() - 45);
+        if(cacheEnabled) {
+            ofDrawBitmapStringHighlight("cache 1/" + ofToString(cache.getInterleave()) +
+                                        " refreshed " + ofToString(100 * cache.getRefreshed(), 0) +
+                                        "% max error " + ofToString(cacheMaxError, 3), 5, ofGetHeight() - 65);
+        }
+    }
+}
+
+void ofApp::draw() {
+    drawOutput(0);
+    updateExport();
     
     //Debug text
     if(debugMode){
         ofSetColor(255);
         ofDrawBitmapStringHighlight(ofToString(ofGetFrameRate(), 0), 5, ofGetHeight() - 5);
+        ofDrawBitmapStringHighlight("p99 " + ofToString(1000 * scheduler.getFrameTimePercentile(.99), 1) + "ms" +
+                                    " late " + ofToString(scheduler.getLateFrames()) +
+                                    " missed " + ofToString(scheduler.getMissedFrames()) +
+                                    " dropped steps " + ofToString(scheduler.getDroppedSteps()), 5, ofGetHeight() - 85);
+        for(int i = 0; i < outputs.size(); i++) {
+            ofDrawBitmapStringHighlight("output " + ofToString(i + 1) +
+                                        " draw " + ofToString(outputs[i]->drawMicros, 0) + "us" +
+                                        " every " + ofToString(1000 * outputs[i]->frameInterval, 1) + "ms",
+                                        5, ofGetHeight() - 105 - 20 * i);
+        }
+        if(frameExport.isOpen()) {
+            ofDrawBitmapStringHighlight("export " + ofToString(frameExport.getPublished()) + " frames " +
+                                        ofToString(frameExport.getPublishMicros(), 0) + "us",
+                                        5, ofGetHeight() - 105 - 20 * outputs.size());
+        }
+#ifdef USE_CAMERA
+        ofDrawBitmapStringHighlight(ofToString(trackerResult.trackCount) + " tracks " +
+                                    ofToString(trackerResult.trackMicros, 0) + "us", 5, ofGetHeight() - 25);
+#endif
         
         ofPushStyle();
         ofPushMatrix();
         ofTranslate(10, 120);
-        ofDrawRectangle(0, 0, 4, stageAmp * 100);
+        ofDrawRectangle(0, 0, 4, renderStageAmp * 100);
         ofTranslate(14, 8);
         ofDrawBitmapStringHighlight(getStageName(stageGoal), 0, 0);
         ofDrawBitmapStringHighlight(getStageName(stage), 0, 100);
@@ -398,6 +505,7 @@ void ofApp::draw() {
         shader.begin();
         shader.setUniformTexture("xyzMap", speakerXYZMap, 0);
         shader.setUniform1i("useConfidence", 0);
+        shader.setUniform1i("useAttributes", 0);
         speakerXYZMap.draw(0,0);
         shader.end();
     } speakerFbo.end();
@@ -406,17 +514,14 @@ void ofApp::draw() {
     //Read back the fbo, and average it on the CPU
     speakerFbo.getTexture().readToPixels(speakerPixels);
     
-    ofxOscMessage brightnessMsg;
-    brightnessMsg.setAddress("/audio/brightness");
     for(int s=0;s<4;s++){
         speakerAmp[s] = 0;
         for(int y=0;y<speakerFbo.getHeight();y++){
             speakerAmp[s] += speakerPixels.getColor(s, y)[0];
         }
         speakerAmp[s] /= speakerFbo.getHeight();
-        brightnessMsg.addFloatArg(speakerAmp[s]);
     }
-    oscSender.sendMessage(brightnessMsg);
+    osc.send("/audio/brightness", {speakerAmp[0], speakerAmp[1], speakerAmp[2], speakerAmp[3]});
     
     //Debug drawing
     if(debugMode){
@@ -470,16 +575,82 @@ void ofApp::draw() {
     
 }
 
+void ofApp::setupExport() {
+    if(!config.exists("export/enabled") || !config.getBoolValue("export/enabled")) {
+        return;
+    }
+    string name = config.exists("export/name") ? config.getValue("export/name") : "/lightleaks";
+    float scale = config.exists("export/scale") ? ofToFloat(config.getValue("export/scale")) : .25;
+    if(frameExport.setup(name, ofGetWidth() * scale, ofGetHeight() * scale)) {
+        exportFrame.allocate(ofGetWidth(), ofGetHeight(), GL_RGBA);
+    }
+}
+
+// the main window before the debug overlay, and the state it was drawn with
+void ofApp::updateExport() {
+    if(!frameExport.isOpen()) {
+        return;
+    }
+    exportFrame.loadScreenData(0, 0, ofGetWidth(), ofGetHeight());
+    FrameExportState state;
+    state.frame = ofGetFrameNum();
+    state.time = scheduler.getTime();
+    state.stage = stage;
+    state.substage = substage;
+    state.stageAmp = renderStageAmp;
+    state.lighthouseAngle = renderLighthouseAngle;
+    state.spotlightCount = spotlightCount;
+    for(int i = 0; i < maxSpotlights; i++) {
+        state.spotlights[i][0] = spotlights[i].x;
+        state.spotlights[i][1] = spotlights[i].y;
+        state.spotlights[i][2] = spotlights[i].z;
+    }
+    frameExport.publish(exportFrame, state);
+}
+
+// upper bound on how much any pixel's brightness changes since the last frame,
+// from the slow stages in shader.frag. only the concentric spheres are smooth,
+// the lighthouse beam and the rising stripes are sawtooths with a hard edge that
+// jumps from 0 to 1 however little time passed, and anything else, like the
+// spotlight following people, counts as a full change too.
+float ofApp::estimateFrameChange() {
+    float change = 1;
+    // the spheres are sin(200 * (radius + offset)), so no pixel moves more than 200
+    // times the offset did. measured between frames rather than from the fastest
+    // the offset ever moves, it comes to rest twice per cycle and can be cached then
+    float time = scheduler.getTime();
+    float spheresOffset = .02 * sinf(time + sinf(time));
+    if(stage == Intermezzo && substage == 2) {
+        change = 200 * fabsf(spheresOffset - previousSpheresOffset);
+    }
+    previousSpheresOffset = spheresOffset;
+    if(stage != previousStage || substage != previousSubstage) {
+        change = 1;
+    }
+    previousStage = stage;
+    previousSubstage = substage;
+    return change;
+}
+
 void ofApp::startStage(Stage stage) {
-    ofxOscMessage msg;
-    msg.setAddress("/audio/scene_change_event");
-    msg.addIntArg(stage);
-    oscSender.sendMessage(msg);
+    osc.sendEvent("/audio/scene_change_event", stage);
+}
+
+// gl objects that aren't shared between contexts, called by the output's own window
+void ofApp::releaseOutput(int i) {
+    outputs[i]->shadedPixels.release();
 }
 
 void ofApp::exit() {
+    if(!outputs.empty()) {
+        releaseOutput(0);
+    }
+    osc.waitForThread(true);
+    frameExport.close();
 #ifdef USE_CAMERA
-    grabber.close();
+    if(trackerEnabled) {
+        tracker.close();
+    }
 #endif
 }
 
@@ -493,6 +664,25 @@ void ofApp::keyPressed(int key) {
     if(key == 's'){
         shader.load("shader");
     }
+    if(key == 't'){
+        cacheEnabled = !cacheEnabled;
+        for(auto& output : outputs) {
+            output->cache.invalidate();
+        }
+    }
+    if(key == '['){
+        cacheMaxError /= 2;
+    }
+    if(key == ']'){
+        cacheMaxError *= 2;
+    }
+    if(key == 'g'){
+        drawMode = GeometryAttributes::DrawMode((drawMode + 1) % 3);
+    }
+    if(key == 'a'){
+        // baked attributes or computed from the xyz map in the shader
+        useAttributes = !useAttributes;
+    }
     if(debugMode){
 #ifdef USE_CAMERA
         if(key == '1'){
@@ -578,11 +768,17 @@ void ofApp::updateCameraCalibration(){
 
 void ofApp::setupTracker() {
     //Tracker
-    grabber.setup(1920, 1080, 25);
-    
-    contourFinder.setSortBySize(true); // makes sorting consistent
-    contourFinder.setMinAreaRadius(minAreaRadius);
-    contourFinder.setMaxAreaRadius(maxAreaRadius);
+    string source = config.exists("tracker/source") ? config.getValue("tracker/source") : "blackmagic";
+    string path = config.exists("tracker/path") ? config.getValue("tracker/path") : "";
+    bool realtime = config.exists("tracker/realtime") ? config.getBoolValue("tracker/realtime") : true;
+    shared_ptr<FrameSource> frameSource = createFrameSource(source, path, realtime);
+    // never make up visitors in the installation, without frames there is no tracking
+    trackerEnabled = frameSource != nullptr;
+    if(trackerEnabled) {
+        tracker.setup(frameSource);
+    } else {
+        ofLogError("setupTracker") << "no frame source \"" << source << "\", tracking is disabled";
+    }
     
     cameraCalibrationCorners[0] = ofVec2f(settings.getValue("corner0x",0),
                                           settings.getValue("corner0y",0));
@@ -594,69 +790,34 @@ void ofApp::setupTracker() {
                                           settings.getValue("corner3y",1080));
     
     setCorner = -1;
-    firstFrame = true;
     
     updateCameraCalibration();
 }
 
+// the vision work happens on the tracker thread, this only picks up its latest result
 void ofApp::updateTracker() {
-    bool newFrame = grabber.update();
-    
-    if(newFrame ) {
-        ofPixels& pixels = grabber.getGrayPixels();
-        if(pixels.getWidth()>0){
-            ofxCv::resize(pixels, grabberSmall, trackScale, trackScale, cv::INTER_AREA);
-            //            cameraBackground.setDifferenceMode(ofxCv::RunningBackground::BRIGHTER); // works on floor, but not walls or if couches are white
-            cameraBackground.setLearningTime(backgroundLearningTime);
-            cameraBackground.update(grabberSmall, grabberThresholded);
-            if(firstFrame){ // first frame from ofxBlackMagic is useless
-                cameraBackground.reset();
-            }
-            ofxCv::blur(grabberThresholded, foregroundBlur);
-            ofxCv::dilate(grabberThresholded, foregroundDilate);
-            contourFinder.setThreshold(contourFinderThreshold);
-            contourFinder.findContours(grabberThresholded);
-            
-            if(contourFinder.getContours().size() > 0){
-                logAudience();
-                ofDrawRectangleangle rect = ofxCv::toOf(contourFinder.getBoundingRect(0));
-                ofVec2f point = rect.getTopLeft(); // corresponds to feet due to angle of camera
-                point /= trackScale;
-                spotlightPosition.update(cameraCalibration.inversetransform(point));
-            }
-            
-            firstFrame = false;
+    TrackerResult result;
+    if(trackerEnabled && tracker.getLatest(result)) {
+        trackerResult = result;
+        if(result.count > 0) {
+            spotlightPosition.update(cameraCalibration.inversetransform(result.target));
+        }
+        // same axis swap as spotlightPos, x is the long side of the room
+        spotlightCount = MIN(result.trackCount, maxSpotlights);
+        for(int i = 0; i < spotlightCount; i++) {
+            ofVec2f room = cameraCalibration.inversetransform(result.tracks[i].position);
+            spotlights[i].set(0, room.y, room.x);
+            spotlightIds[i] = result.tracks[i].id;
         }
     }
     
-    if(contourFinder.getContours().size() > 0){
+    if(trackerResult.count > 0){
         spotlightThresholder += dt;
     } else {
         spotlightThresholder -= dt;
     }
     spotlightThresholder = ofClamp(spotlightThresholder, 0, delaySpotlight);
 }
-
-void ofApp::logAudience() {
-    string logLine = buildContourLogLine(contourFinder);
-    ofFile out("log.txt", ofFile::Append);
-    out << logLine << endl;
-}
-
-#include "Poco/DateTimeFormat.h"
-string buildContourLogLine(ofxCv::ContourFinder& finder) {
-    int n = finder.size();
-    vector<string> record;
-    record.push_back(ofGetTimestampString(Poco::DateTimeFormat::ISO8601_FRAC_FORMAT));
-    record.push_back(ofToString(n));
-    for(int i = 0; i < n; i++) {
-        stringstream str;
-        cv::Rect rect = finder.getBoundingRect(i);
-        str << rect.x << " " << rect.y << " " << rect.width << " " << rect.height;
-        record.push_back(str.str());
-    }
-    return ofJoinString(record, "\t");
-}
 #endif
 
 
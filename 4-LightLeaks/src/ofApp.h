@@ -6,13 +6,14 @@
 #include "CoordWarp.h"
 #include "ofxXmlSettings.h"
 #include "ofxBiquadFilter.h"
-#include "ofxOsc.h"
-
-//#define USE_CAMERA
-
-#ifdef USE_CAMERA
-#include "ofxBlackMagic.h"
-#endif
+#include "OscThread.h"
+#include "AudienceTracker.h"
+#include "GeometryAttributes.h"
+#include "TemporalCache.h"
+#include "ShowScheduler.h"
+#include "FrameExport.h"
+#include "CpuShader.h"
+#include "AssetLoader.h"
 
 enum Stage {
     Lighthouse=0,
@@ -21,11 +22,26 @@ enum Stage {
     Linescan
 };
 
+// one projector window, drawing its own part of the map
+struct Output {
+    ofRectangle region; // in xyzMap pixels
+    // fbos and queries aren't shared between contexts, so each window has its own
+    TemporalCache cache;
+    ShadedPixelCounter shadedPixels;
+    float drawMicros = 0; // cpu time to submit this output
+    float frameInterval = 0; // time between draws of this output, in seconds
+    uint64_t lastDraw = 0;
+};
+
 class ofApp : public ofBaseApp {
 public:
-    void setup(), setupSpeakers();
-    void update(), updateOsc();
+    void setup(), setupStage(), setupSpeakers();
+    void update(), advance(double now), updateStage(), updateOsc();
 	void draw();
+    void addOutput(ofRectangle region);
+    void drawOutput(int i);
+    void releaseOutput(int i);
+    ShowUniforms getUniforms(float time, float windowHeight);
     void exit();
 	void keyPressed(int key);
     void mouseMoved(int x, int y);
@@ -35,11 +51,25 @@ public:
     int debugStage;
     
     
-    float dt, previousTime;
+    ShowScheduler scheduler;
+    float dt; // fixed simulation step
+    // stage state interpolated between the last two steps, for drawing
+    float lastStageAmp, lastLighthouseAngle;
+    float renderStageAmp, renderLighthouseAngle;
 	
-	ofFloatImage xyzMap;
-    ofFloatImage normalMap;
-    ofFloatImage confidenceMap;
+    MapTexture xyzMap;
+    bool mapsLoaded() const;
+    GeometryAttributes attributes;
+    GeometryAttributes::DrawMode drawMode;
+    bool useAttributes;
+    vector< shared_ptr<Output> > outputs;
+    bool cacheEnabled;
+    float cacheMaxError;
+    float estimateFrameChange();
+    float frameChange; // shared by all outputs this frame
+    Stage previousStage;
+    int previousSubstage;
+    float previousSpheresOffset;
 	ofShader shader;
     
     //Settings
@@ -57,11 +87,14 @@ public:
     //Lighthouse
     float lighthouseAngle;
 
-#ifdef USE_CAMERA
     //Spotlight
     float spotlightThresholder;
     ofxBiquadFilter2f spotlightPosition;
-#endif
+    // every tracked visitor in model coordinates, for the shader
+    static const int maxSpotlights = 8;
+    ofVec3f spotlights[maxSpotlights];
+    int spotlightIds[maxSpotlights];
+    int spotlightCount;
     
     //Speaker sampling
     ofFloatImage speakerXYZMap;
@@ -75,28 +108,27 @@ public:
     int scanDir;
     
     bool setupCalled;
-    vector< shared_ptr<ofAppBaseWindow> > windows;
     
 #ifdef USE_CAMERA
     void setupTracker(), updateTracker();
     void updateCameraCalibration();
-    void logAudience();
     
     //Tracking
-    ofxBlackMagic grabber;
+    AudienceTracker tracker;
+    bool trackerEnabled;
+    TrackerResult trackerResult;
     int photoCounter;
-    cv::Mat grabberSmall, grabberThresholded;
     
-    ofxCv::RunningBackground cameraBackground;
-    ofxCv::ContourFinder contourFinder;
     coordWarping cameraCalibration;
     ofVec2f cameraCalibrationCorners[4];
-    bool firstFrame;
     int setCorner;
 #endif
     
     //OSC
-    ofxOscSender oscSender;
-    ofxOscReceiver oscBeat;
-    float lastBeat;
+    OscThread osc;
+    
+    //Export to other processes
+    void setupExport(), updateExport();
+    FrameExport frameExport;
+    ofTexture exportFrame;
 };
@@ -0,0 +1,130 @@
+#include "PyramidView.h"
+
+using namespace cv;
+
+PyramidView::PyramidView()
+:tileSize(256)
+,gpuBytes(0) {
+}
+
+void PyramidView::build(const Mat& image, int tileSize) {
+    this->tileSize = tileSize;
+    gpuBytes = 0;
+    levels.clear();
+
+    Mat base;
+    if(image.depth() == CV_32F) {
+        image.convertTo(base, CV_8U, 255);
+    } else {
+        base = image.clone();
+    }
+    // halve until a level fits in one tile
+    while(true) {
+        Level level;
+        level.pixels = base;
+        level.columns = (base.cols + tileSize - 1) / tileSize;
+        level.rows = (base.rows + tileSize - 1) / tileSize;
+        level.tiles.resize(level.columns * level.rows);
+        levels.push_back(level);
+        if(base.cols <= tileSize && base.rows <= tileSize) {
+            break;
+        }
+        Mat half;
+        resize(base, half, cv::Size((base.cols + 1) / 2, (base.rows + 1) / 2), 0, 0, INTER_AREA);
+        base = half;
+    }
+}
+
+bool PyramidView::upload(int i, int column, int row) {
+    Level& level = levels[i];
+    ofTexture& tile = level.tiles[row * level.columns + column];
+    if(tile.isAllocated()) {
+        return false;
+    }
+    cv::Rect rect(column * tileSize, row * tileSize, tileSize, tileSize);
+    rect &= cv::Rect(0, 0, level.pixels.cols, level.pixels.rows);
+    // the roi isn't continuous, and gl wants rows back to back
+    Mat pixels = level.pixels(rect).clone();
+    tile.allocate(rect.width, rect.height, GL_LUMINANCE8, ofGetUsingArbTex(), GL_LUMINANCE, GL_UNSIGNED_BYTE);
+    tile.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    tile.loadData(pixels.ptr<unsigned char>(), rect.width, rect.height, GL_LUMINANCE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gpuBytes += rect.area();
+    return true;
+}
+
+// visible is in level 0 pixels, the level is drawn scaled up to match
+void PyramidView::drawLevel(int i, const ofRectangle& visible, int maxUploads, int& uploads, int& waiting) {
+    Level& level = levels[i];
+    float levelScale = 1 << i;
+    int x0 = MAX(0, (int) floorf(visible.getLeft() / levelScale / tileSize));
+    int y0 = MAX(0, (int) floorf(visible.getTop() / levelScale / tileSize));
+    int x1 = MIN(level.columns - 1, (int) floorf(visible.getRight() / levelScale / tileSize));
+    int y1 = MIN(level.rows - 1, (int) floorf(visible.getBottom() / levelScale / tileSize));
+    ofPushMatrix();
+    ofScale(levelScale, levelScale);
+    for(int row = y0; row <= y1; row++) {
+        for(int column = x0; column <= x1; column++) {
+            ofTexture& tile = level.tiles[row * level.columns + column];
+            if(!tile.isAllocated()) {
+                if(maxUploads > 0 && uploads >= maxUploads) {
+                    waiting++;
+                    continue;
+                }
+                upload(i, column, row);
+                uploads++;
+            }
+            tile.draw(column * tileSize, row * tileSize);
+        }
+    }
+    ofPopMatrix();
+}
+
+int PyramidView::draw(const ofRectangle& viewport, float x, float y, float scale, int maxUploads) {
+    if(levels.empty()) {
+        return 0;
+    }
+    // the finest level with at least one of its pixels per screen pixel
+    int detail = 0;
+    if(scale < 1) {
+        detail = MIN((int) floorf(log2f(1 / scale)), (int) levels.size() - 1);
+    }
+    int coarsest = levels.size() - 1;
+
+    int uploads = 0, waiting = 0;
+    ofPushView();
+    ofViewport(viewport);
+    ofSetupScreenPerspective(viewport.width, viewport.height);
+    ofPushMatrix();
+    ofTranslate(viewport.width / 2, viewport.height / 2);
+    ofScale(scale, scale);
+    ofTranslate(-x, -y);
+    ofRectangle visible(x - viewport.width / 2 / scale, y - viewport.height / 2 / scale,
+                        viewport.width / scale, viewport.height / scale);
+    // the coarsest level is the fallback under the detail, so it never waits
+    int fallbackUploads = 0;
+    drawLevel(coarsest, visible, 0, fallbackUploads, waiting);
+    if(detail != coarsest) {
+        drawLevel(detail, visible, maxUploads, uploads, waiting);
+    }
+    ofPopMatrix();
+    ofPopView();
+    return waiting;
+}
+
+int PyramidView::getWidth() const {
+    return levels.empty() ? 0 : levels[0].pixels.cols;
+}
+
+int PyramidView::getHeight() const {
+    return levels.empty() ? 0 : levels[0].pixels.rows;
+}
+
+int PyramidView::getLevels() const {
+    return levels.size();
+}
+
+size_t PyramidView::getGpuBytes() const {
+    return gpuBytes;
+}
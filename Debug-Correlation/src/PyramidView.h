@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// a gray image kept as a pyramid of halved levels cut into tiles, for zooming
+// around maps much bigger than the screen. build() only touches the cpu so it can
+// run on a loader thread. tiles are uploaded the first time they are visible, a
+// few per frame, and until then the coarsest level, which is always uploaded,
+// shows through. float images are 0-1 and kept as 8 bit.
+class PyramidView {
+public:
+    PyramidView();
+    void build(const cv::Mat& image, int tileSize = 256);
+
+    // draws the image into viewport with image pixel (x, y) at its center and
+    // scale screen pixels per image pixel. returns how many tiles are still
+    // waiting to be uploaded for this view.
+    int draw(const ofRectangle& viewport, float x, float y, float scale, int maxUploads = 16);
+
+    int getWidth() const;
+    int getHeight() const;
+    int getLevels() const;
+    size_t getGpuBytes() const;
+
+protected:
+    struct Level {
+        cv::Mat pixels;
+        int columns, rows;
+        vector<ofTexture> tiles;
+    };
+    bool upload(int level, int column, int row);
+    void drawLevel(int level, const ofRectangle& visible, int maxUploads, int& uploads, int& waiting);
+
+    vector<Level> levels;
+    int tileSize;
+    size_t gpuBytes;
+};
@@ -0,0 +1,85 @@
+#include "ScanCache.h"
+#include "CalibrationMetrics.h"
+
+ScanCache::ScanCache(int capacity)
+:capacity(capacity) {
+}
+
+void ScanCache::request(string path) {
+    if(pending.count(path)) {
+        return;
+    }
+    for(auto& scan : scans) {
+        if(scan->path == path) {
+            return;
+        }
+    }
+    std::shared_future<ofFloatPixels> camConfidence = loader.loadFloat(path + "/camConfidence.exr").share();
+    std::shared_future<ofFloatPixels> proConfidence = loader.loadFloat(path + "/proConfidence.exr").share();
+    std::shared_future<ofShortPixels> proMap = loader.loadShort(path + "/proMap.png").share();
+    pending[path] = std::async(std::launch::async, [=]() {
+        return decode(path, camConfidence, proConfidence, proMap);
+    });
+}
+
+shared_ptr<CorrelationScan> ScanCache::decode(string path, std::shared_future<ofFloatPixels> camConfidence,
+                                              std::shared_future<ofFloatPixels> proConfidence,
+                                              std::shared_future<ofShortPixels> proMap) {
+    float start = ofGetElapsedTimef();
+    shared_ptr<CorrelationScan> scan(new CorrelationScan);
+    scan->path = path;
+    scan->camConfidence = camConfidence.get();
+    scan->proConfidence = proConfidence.get();
+    scan->proMap = proMap.get();
+    if(!scan->camConfidence.isAllocated() || !scan->proConfidence.isAllocated() || !scan->proMap.isAllocated()) {
+        return nullptr;
+    }
+    scan->proMap.setNumChannels(3);
+
+    Mat proConfidenceMat = toCv(scan->proConfidence);
+    Mat camConfidenceMat = toCv(scan->camConfidence);
+    computeNonmatch(proConfidenceMat, toCv(scan->proMap), camConfidenceMat, scan->nonmatch);
+    scan->proView.build(proConfidenceMat);
+    scan->camView.build(camConfidenceMat);
+    scan->nonmatchView.build(scan->nonmatch);
+    scan->decodeSeconds = ofGetElapsedTimef() - start;
+    return scan;
+}
+
+shared_ptr<CorrelationScan> ScanCache::get(string path) {
+    for(auto it = scans.begin(); it != scans.end(); it++) {
+        if((*it)->path == path) {
+            // most recently used goes to the front
+            scans.splice(scans.begin(), scans, it);
+            return scans.front();
+        }
+    }
+    if(failed.count(path)) {
+        return nullptr;
+    }
+    request(path);
+    auto it = pending.find(path);
+    if(it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return nullptr;
+    }
+    shared_ptr<CorrelationScan> scan = it->second.get();
+    pending.erase(it);
+    if(!scan) {
+        ofLogWarning("ScanCache") << "can't load " << path;
+        failed.insert(path);
+        return nullptr;
+    }
+    scans.push_front(scan);
+    while(scans.size() > capacity) {
+        scans.pop_back();
+    }
+    return scan;
+}
+
+bool ScanCache::isPending(string path) const {
+    return pending.count(path) > 0;
+}
+
+int ScanCache::getSize() const {
+    return scans.size();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "AssetLoader.h"
+#include "PyramidView.h"
+
+// everything Debug-Correlation shows for one scan
+struct CorrelationScan {
+    string path;
+    ofFloatPixels camConfidence, proConfidence;
+    ofShortPixels proMap;
+    cv::Mat nonmatch;
+    PyramidView camView, proView, nonmatchView;
+    float decodeSeconds;
+};
+
+// decoded scans, the most recently used first. request() starts decoding a scan
+// in the background, the images side by side on the loader and the nonmatch and
+// pyramids on a thread of their own, so flipping between scans that are already
+// in the cache costs nothing and the next one can be fetched ahead of time.
+class ScanCache {
+public:
+    ScanCache(int capacity = 4);
+    void request(string path);
+    // the scan if it is decoded, otherwise null after making sure it is requested.
+    // scans that can't be loaded are only tried once
+    shared_ptr<CorrelationScan> get(string path);
+    bool isPending(string path) const;
+    int getSize() const;
+
+protected:
+    shared_ptr<CorrelationScan> decode(string path, std::shared_future<ofFloatPixels> camConfidence,
+                                       std::shared_future<ofFloatPixels> proConfidence,
+                                       std::shared_future<ofShortPixels> proMap);
+
+    AssetLoader loader;
+    int capacity;
+    list<shared_ptr<CorrelationScan>> scans;
+    map<string, std::future<shared_ptr<CorrelationScan>>> pending;
+    set<string> failed;
+};
@@ -1,14 +1,15 @@
 #include "ofMain.h"
 #include "ofxCv.h"
+#include "ScanCache.h"
 
 using namespace cv;
 using namespace ofxCv;
 
-void lookupCamPosition(ofShortImage& proMap,
+void lookupCamPosition(const ofShortPixels& proMap,
                        unsigned short px, unsigned short py,
                        unsigned short& cx, unsigned short& cy) {
     const Mat proMapMat = toCv(proMap);
-    Vec3w camColor = proMapMat.at<Vec3w>(py, px);
+    Vec3w camColor = proMapMat.at<Vec3w>(MIN(py, proMapMat.rows - 1), MIN(px, proMapMat.cols - 1));
     cx = camColor[0];
     cy = camColor[1];
 }
@@ -16,55 +17,62 @@ void lookupCamPosition(ofShortImage& proMap,
 class ofApp : public ofBaseApp {
 public:
     int ox, oy;
-    ofFloatImage camConfidence;
-    ofFloatImage proConfidence;
-    ofShortImage proMap;
-    ofImage nonmatch;
+    float zoom;
+    ScanCache cache;
+    vector<string> scanPaths;
+    string current;
+    shared_ptr<CorrelationScan> scan;
     void setup() {
         ofBackground(0);
-        ofSetFrameRate(30);
+        ofSetFrameRate(60);
         ofSetLineWidth(2);
+        // every scan with a proMap, '[' and ']' flip through them
+        ofDirectory dir("../../../SharedData/");
+        dir.listDir();
+        dir.sort();
+        for(ofFile file : dir) {
+            if(file.isDirectory() && ofFile(file.path() + "/proMap.png").exists()) {
+                scanPaths.push_back(file.path());
+            }
+        }
         loadScan("../../../SharedData/3-scan-1906-lowconf/");
         ox = 0, oy = 0;
+        zoom = 16;
+    }
+    void update() {
+        shared_ptr<CorrelationScan> cached = cache.get(current);
+        if(cached) {
+            scan = cached;
+        }
     }
     void draw() {
-        if(camConfidence.isAllocated()) {
+        if(scan) {
             int height = ofGetHeight();
             int width = ofGetWidth() / 2;
-            int scale = ofGetMousePressed() ? 2 : 16;
-            unsigned short px = ox + ofMap(mouseX, 0, ofGetWidth(), 0, proConfidence.getWidth());
-            unsigned short py = oy + ofMap(mouseY, 0, ofGetHeight(), 0, proConfidence.getHeight());
+            float scale = ofGetMousePressed() ? zoom / 8 : zoom;
+            unsigned short px = ox + ofMap(mouseX, 0, ofGetWidth(), 0, scan->proConfidence.getWidth(), true);
+            unsigned short py = oy + ofMap(mouseY, 0, ofGetHeight(), 0, scan->proConfidence.getHeight(), true);
             
             ofNoFill();
             
-            ofPushView();
-            ofViewport(ofRectangle(0, 0, width, height));
-            ofSetupScreenPerspective();
-            ofPushMatrix();
-            ofTranslate(width / 2, height / 2);
-            ofScale(scale, scale);
-            if(ofGetKeyPressed('n')) {
-                nonmatch.draw(-px, -py);
-            } else {
-                proConfidence.draw(-px, -py);
-            }
-            ofDrawRectangle(0, 0, 1, 1);
-            ofPopMatrix();
-            ofPopView();
+            ofRectangle proViewport(0, 0, width, height);
+            PyramidView& proView = ofGetKeyPressed('n') ? scan->nonmatchView : scan->proView;
+            int waiting = proView.draw(proViewport, px + .5, py + .5, scale);
+            drawMarker(proViewport, scale);
             
             unsigned short cx, cy;
-            lookupCamPosition(proMap, px, py, cx, cy);
+            lookupCamPosition(scan->proMap, px, py, cx, cy);
+            
+            ofRectangle camViewport(width, 0, width, height);
+            waiting += scan->camView.draw(camViewport, cx + .5, cy + .5, scale);
+            drawMarker(camViewport, scale);
             
-            ofPushView();
-            ofViewport(ofRectangle(width, 0, width, height));
-            ofSetupScreenPerspective();
-            ofPushMatrix();
-            ofTranslate(width / 2, height / 2);
-            ofScale(scale, scale);
-            camConfidence.draw(-cx, -cy);
-            ofDrawRectangle(0, 0, 1, 1);
-            ofPopMatrix();
-            ofPopView();
+            ofDrawBitmapStringHighlight(ofFilePath::getBaseName(scan->path) +
+                                        (current != scan->path ? " (loading " + ofFilePath::getBaseName(current) + ")" : "") +
+                                        "\nzoom " + ofToString(scale, 3) + "x, " + ofToString(waiting) + " tiles waiting" +
+                                        "\ndecoded in " + ofToString(scan->decodeSeconds, 2) + "s, " +
+                                        ofToString(cache.getSize()) + " scans cached" +
+                                        "\npro " + ofToString(px) + " " + ofToString(py) + " cam " + ofToString(cx) + " " + ofToString(cy), 10, 20);
             
 //            float totalHeight = camConfidence.getHeight() + proConfidence.getHeight();
 //            float scale = ofGetHeight() / totalHeight;
@@ -104,9 +112,20 @@ public:
 //            }
         }
     }
+    // the selected pixel stays in the middle of each view
+    void drawMarker(const ofRectangle& viewport, float scale) {
+        ofPushView();
+        ofViewport(viewport);
+        ofSetupScreenPerspective(viewport.width, viewport.height);
+        ofDrawRectangle(viewport.width / 2 - scale / 2, viewport.height / 2 - scale / 2, MAX(scale, 1), MAX(scale, 1));
+        ofPopView();
+    }
     void mouseMoved(int x, int y) {
         ox = 0, oy = 0;
     }
+    void mouseScrolled(int x, int y, float scrollX, float scrollY) {
+        zoom = ofClamp(zoom * powf(1.25, scrollY), 1. / 64, 64);
+    }
     void keyPressed(int key) {
         if(key == OF_KEY_LEFT) {
             ox--;
@@ -120,32 +139,24 @@ public:
         if(key == OF_KEY_DOWN) {
             oy++;
         }
+        if(key == '[' || key == ']') {
+            stepScan(key == '[' ? -1 : +1);
+        }
     }
-    void loadScan(string path) {
-        camConfidence.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-        proConfidence.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-        nonmatch.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-        camConfidence.load(path + "/camConfidence.exr");
-        proConfidence.load(path + "/proConfidence.exr");
-        proMap.setUseTexture(false);
-        proMap.load(path + "/proMap.png");
-        
-        imitate(nonmatch, proMap, CV_8UC1);
-        Mat pcMat = toCv(proConfidence);
-        Mat ccMat = toCv(camConfidence);
-        Mat pmMat = toCv(proMap);
-        Mat nmMat = toCv(nonmatch);
-        int rows = pcMat.rows;
-        int cols = pcMat.cols;
-        for(int row = 0; row < rows; row++) {
-            for(int col = 0; col < cols; col++) {
-                Vec3w cxy = pmMat.at<Vec3w>(row, col);
-                float generatedConfidence = ccMat.at<float>(cxy[1], cxy[0]);
-                float originalConfidence = pcMat.at<float>(row, col);
-                nmMat.at<unsigned char>(row, col) = 255 * fabsf(generatedConfidence - originalConfidence);
-            }
+    void stepScan(int direction) {
+        if(scanPaths.empty()) {
+            return;
         }
-        nonmatch.update();
+        int n = scanPaths.size();
+        auto it = find(scanPaths.begin(), scanPaths.end(), current);
+        int i = it == scanPaths.end() ? 0 : (it - scanPaths.begin() + direction + n) % n;
+        loadScan(scanPaths[i]);
+        // fetch the one after ahead of time
+        cache.request(scanPaths[(i + direction + n) % n]);
+    }
+    void loadScan(string path) {
+        current = ofFilePath::removeTrailingSlash(path);
+        cache.request(current);
     }
     void dragEvent(ofDragInfo dragInfo) {
         if(dragInfo.files.size() == 1) {
@@ -0,0 +1,251 @@
+#include "MaskCanvas.h"
+
+MaskCanvas::MaskCanvas()
+:width(0)
+,height(0)
+,tileSize(256)
+,columns(0)
+,rows(0)
+,drawing(false)
+,pendingSaves(0) {
+}
+
+MaskCanvas::~MaskCanvas() {
+	if(saver.joinable()) {
+		// a job without a filename tells the saver to stop once it has written
+		// everything before it. closing first would drop the last save
+		toSave.send(SaveJob());
+		saver.join();
+	}
+	toSave.close();
+}
+
+void MaskCanvas::setup(int width, int height, int tileSize) {
+	this->width = width;
+	this->height = height;
+	this->tileSize = tileSize;
+	columns = (width + tileSize - 1) / tileSize;
+	rows = (height + tileSize - 1) / tileSize;
+	pixels.allocate(width, height, OF_IMAGE_GRAYSCALE);
+	pixels.set(0);
+	texture.allocate(width, height, GL_LUMINANCE8, ofGetUsingArbTex(), GL_LUMINANCE, GL_UNSIGNED_BYTE);
+	texture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+	dirtyTiles.assign(columns * rows, true);
+	dirtyTexture.set(0, 0, width, height);
+	strokes.clear();
+	undone.clear();
+	if(!saver.joinable()) {
+		saved.allocate(width, height, OF_IMAGE_GRAYSCALE);
+		saver = std::thread([this]() {
+			saveThread();
+		});
+	}
+}
+
+void MaskCanvas::beginStroke(ofVec2f point, float radius, unsigned char value) {
+	MaskStroke stroke;
+	stroke.points.push_back(point);
+	stroke.radius = radius;
+	stroke.value = value;
+	stroke.bounds.set(point.x - radius - 1, point.y - radius - 1, radius * 2 + 2, radius * 2 + 2);
+	strokes.push_back(stroke);
+	undone.clear();
+	drawing = true;
+	rasterizeCapsule(point, point, radius, value, stroke.bounds);
+	markDirty(stroke.bounds);
+}
+
+void MaskCanvas::addPoint(ofVec2f point) {
+	if(!drawing) {
+		return;
+	}
+	MaskStroke& stroke = strokes.back();
+	ofVec2f prev = stroke.points.back();
+	if(prev == point) {
+		return;
+	}
+	stroke.points.push_back(point);
+	float reach = stroke.radius + 1;
+	ofRectangle area(MIN(prev.x, point.x) - reach, MIN(prev.y, point.y) - reach,
+					 fabsf(point.x - prev.x) + reach * 2, fabsf(point.y - prev.y) + reach * 2);
+	stroke.bounds.growToInclude(area);
+	rasterizeCapsule(prev, point, stroke.radius, stroke.value, area);
+	markDirty(area);
+}
+
+void MaskCanvas::endStroke() {
+	drawing = false;
+}
+
+bool MaskCanvas::undo() {
+	if(strokes.empty() || drawing) {
+		return false;
+	}
+	undone.push_back(strokes.back());
+	strokes.pop_back();
+	rebuild(undone.back().bounds);
+	return true;
+}
+
+bool MaskCanvas::redo() {
+	if(undone.empty() || drawing) {
+		return false;
+	}
+	strokes.push_back(undone.back());
+	undone.pop_back();
+	rasterizeStroke(strokes.back(), strokes.back().bounds);
+	markDirty(strokes.back().bounds);
+	return true;
+}
+
+// clears the area and replays every stroke that touches it
+void MaskCanvas::rebuild(const ofRectangle& area) {
+	int x0 = MAX(0, (int) floorf(area.getLeft())), x1 = MIN(width, (int) ceilf(area.getRight()));
+	int y0 = MAX(0, (int) floorf(area.getTop())), y1 = MIN(height, (int) ceilf(area.getBottom()));
+	for(int y = y0; y < y1; y++) {
+		memset(pixels.getData() + y * width + x0, 0, MAX(0, x1 - x0));
+	}
+	for(const MaskStroke& stroke : strokes) {
+		if(stroke.bounds.intersects(area)) {
+			rasterizeStroke(stroke, area);
+		}
+	}
+	markDirty(area);
+}
+
+void MaskCanvas::rasterizeStroke(const MaskStroke& stroke, const ofRectangle& clip) {
+	rasterizeCapsule(stroke.points[0], stroke.points[0], stroke.radius, stroke.value, clip);
+	for(int i = 1; i < stroke.points.size(); i++) {
+		rasterizeCapsule(stroke.points[i - 1], stroke.points[i], stroke.radius, stroke.value, clip);
+	}
+}
+
+// every pixel within radius of the segment ab, with a one pixel soft edge.
+// painting only raises pixels and erasing only lowers them, so overlapping
+// capsules in one stroke don't build up at the joints.
+void MaskCanvas::rasterizeCapsule(ofVec2f a, ofVec2f b, float radius, unsigned char value, const ofRectangle& clip) {
+	float reach = radius + 1;
+	int x0 = MAX(MAX(0, (int) floorf(MIN(a.x, b.x) - reach)), (int) floorf(clip.getLeft()));
+	int x1 = MIN(MIN(width, (int) ceilf(MAX(a.x, b.x) + reach)), (int) ceilf(clip.getRight()));
+	int y0 = MAX(MAX(0, (int) floorf(MIN(a.y, b.y) - reach)), (int) floorf(clip.getTop()));
+	int y1 = MIN(MIN(height, (int) ceilf(MAX(a.y, b.y) + reach)), (int) ceilf(clip.getBottom()));
+	ofVec2f ab = b - a;
+	float lengthSquared = ab.lengthSquared();
+	for(int y = y0; y < y1; y++) {
+		unsigned char* row = pixels.getData() + y * width;
+		for(int x = x0; x < x1; x++) {
+			ofVec2f ap = ofVec2f(x + .5, y + .5) - a;
+			float t = lengthSquared > 0 ? ofClamp(ap.dot(ab) / lengthSquared, 0, 1) : 0;
+			float distance = (ap - ab * t).length();
+			float coverage = ofClamp(radius + .5 - distance, 0, 1);
+			if(coverage == 0) {
+				continue;
+			}
+			unsigned char level = coverage * 255;
+			if(value) {
+				row[x] = MAX(row[x], level);
+			} else {
+				row[x] = MIN(row[x], 255 - level);
+			}
+		}
+	}
+}
+
+void MaskCanvas::markDirty(const ofRectangle& area) {
+	ofRectangle clipped = area.getIntersection(ofRectangle(0, 0, width, height));
+	if(clipped.isEmpty()) {
+		return;
+	}
+	if(dirtyTexture.isEmpty()) {
+		dirtyTexture = clipped;
+	} else {
+		dirtyTexture.growToInclude(clipped);
+	}
+	int tx0 = clipped.getLeft() / tileSize, tx1 = MIN(columns - 1, (int) (clipped.getRight() / tileSize));
+	int ty0 = clipped.getTop() / tileSize, ty1 = MIN(rows - 1, (int) (clipped.getBottom() / tileSize));
+	for(int ty = ty0; ty <= ty1; ty++) {
+		for(int tx = tx0; tx <= tx1; tx++) {
+			dirtyTiles[ty * columns + tx] = true;
+		}
+	}
+}
+
+void MaskCanvas::draw(float x, float y) {
+	if(!dirtyTexture.isEmpty()) {
+		// whole rows of the dirty area, so they are contiguous in pixels
+		int y0 = MAX(0, (int) floorf(dirtyTexture.getTop()));
+		int y1 = MIN(height, (int) ceilf(dirtyTexture.getBottom()));
+		const ofTextureData& data = texture.getTextureData();
+		glBindTexture(data.textureTarget, data.textureID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(data.textureTarget, 0, 0, y0, width, y1 - y0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels.getData() + y0 * width);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(data.textureTarget, 0);
+		dirtyTexture.set(0, 0, 0, 0);
+	}
+	texture.draw(x, y);
+}
+
+void MaskCanvas::save(string filename) {
+	SaveJob job;
+	job.filename = filename;
+	for(int ty = 0; ty < rows; ty++) {
+		for(int tx = 0; tx < columns; tx++) {
+			if(!dirtyTiles[ty * columns + tx]) {
+				continue;
+			}
+			ofRectangle tile(tx * tileSize, ty * tileSize, MIN(tileSize, width - tx * tileSize), MIN(tileSize, height - ty * tileSize));
+			ofPixels tilePixels;
+			pixels.cropTo(tilePixels, tile.x, tile.y, tile.width, tile.height);
+			job.tiles.push_back(make_pair(tile, tilePixels));
+			dirtyTiles[ty * columns + tx] = false;
+		}
+	}
+	pendingSaves++;
+	toSave.send(std::move(job));
+}
+
+void MaskCanvas::saveThread() {
+	SaveJob job;
+	bool done = false;
+	while(!done && toSave.receive(job)) {
+		if(job.filename.empty()) {
+			break;
+		}
+		for(auto& tile : job.tiles) {
+			tile.second.pasteInto(saved, tile.first.x, tile.first.y);
+		}
+		// releases come faster than pngs encode, only the newest one matters
+		SaveJob newer;
+		bool skipped = false;
+		while(toSave.tryReceive(newer)) {
+			if(newer.filename.empty()) {
+				done = true;
+				break;
+			}
+			for(auto& tile : newer.tiles) {
+				tile.second.pasteInto(saved, tile.first.x, tile.first.y);
+			}
+			job.filename = newer.filename;
+			pendingSaves--;
+			skipped = true;
+		}
+		if(skipped) {
+			ofLogVerbose("MaskCanvas") << "skipped saves, writing " << job.filename;
+		}
+		ofSaveImage(saved, job.filename);
+		pendingSaves--;
+	}
+}
+
+int MaskCanvas::getStrokeCount() const {
+	return strokes.size();
+}
+
+int MaskCanvas::getPendingSaves() const {
+	return pendingSaves;
+}
+
+const ofPixels& MaskCanvas::getPixels() const {
+	return pixels;
+}
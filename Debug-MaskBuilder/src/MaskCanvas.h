@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ofMain.h"
+
+// one press-drag-release of the brush
+struct MaskStroke {
+	vector<ofVec2f> points;
+	float radius;
+	unsigned char value; // 255 paints, 0 erases
+	ofRectangle bounds;
+};
+
+// the mask lives in an 8 bit buffer on the cpu. strokes are rasterized as
+// antialiased capsules between consecutive mouse positions, so the cost follows
+// the area touched rather than the distance travelled. only the rows that changed
+// go to the texture each frame, only the tiles that changed go to the saver
+// thread, and undo replays the remaining strokes over the area of the removed one.
+class MaskCanvas {
+public:
+	MaskCanvas();
+	~MaskCanvas();
+	void setup(int width, int height, int tileSize = 256);
+
+	void beginStroke(ofVec2f point, float radius, unsigned char value);
+	void addPoint(ofVec2f point);
+	void endStroke();
+	bool undo();
+	bool redo();
+
+	// uploads the dirty area to the texture and draws it
+	void draw(float x, float y);
+	// encodes the mask to filename on a background thread. only tiles changed
+	// since the last save are handed over
+	void save(string filename);
+
+	int getStrokeCount() const;
+	int getPendingSaves() const;
+	const ofPixels& getPixels() const;
+
+protected:
+	void rasterizeCapsule(ofVec2f a, ofVec2f b, float radius, unsigned char value, const ofRectangle& clip);
+	void rasterizeStroke(const MaskStroke& stroke, const ofRectangle& clip);
+	void markDirty(const ofRectangle& area);
+	void rebuild(const ofRectangle& area);
+
+	struct SaveJob {
+		string filename;
+		vector<pair<ofRectangle, ofPixels>> tiles;
+	};
+	void saveThread();
+
+	ofPixels pixels;
+	ofTexture texture;
+	int width, height, tileSize, columns, rows;
+	ofRectangle dirtyTexture;
+	vector<bool> dirtyTiles;
+
+	vector<MaskStroke> strokes, undone;
+	bool drawing;
+
+	ofThreadChannel<SaveJob> toSave;
+	std::thread saver;
+	std::atomic<int> pendingSaves;
+	ofPixels saved; // what has been handed to the saver, only it touches this after setup
+};
@@ -1,50 +1,30 @@
 #include "ofMain.h"
 #include "ofAppGLFWWindow.h"
+#include "MaskCanvas.h"
 
 int sw = 1920*2, sh = 1200, sc = 1;
 
 class ofApp : public ofBaseApp {
 public:
-	ofFbo fbo;
-	ofVec2f mouseCur, mousePrev;
+	MaskCanvas canvas;
+	ofVec2f mouseCur;
 	float radius;
 	int screen;
 	
 	void setup() {
 		radius = 10;
 		screen = 0;
-		fbo.allocate(sw, sh);
-		fbo.begin();
-		ofClear(0, 255);
-		fbo.end();
+		canvas.setup(sw, sh);
 		ofHideCursor();
         
         ofSetWindowPosition(sh,0);
         ofSetWindowShape(sw, sh);
 
-	}
-	void update() {
-		fbo.begin();
-        ofPushStyle();
-		if(ofGetKeyPressed()) {
-			ofSetColor(0);
-		} else {
-			ofSetColor(255);
-		}
-		if(ofGetMousePressed()) {
-			float length = mousePrev.distance(mouseCur);
-			for(int i = 0; i < length; i++) {
-				ofDrawCircle(mousePrev.getInterpolated(mouseCur, i / length), radius);
-			}
-			mousePrev = mouseCur;
-		}
-		ofPopStyle();
-		fbo.end();
 	}
 	void draw() {
 		ofBackground(0);
 		ofTranslate(sw * screen, 0);
-		fbo.draw(0, 0);
+		canvas.draw(0, 0);
 		ofPushStyle();
 		ofNoFill();
 		ofSetColor(255);
@@ -53,15 +33,20 @@ public:
 		ofSetColor(255, 64);
 		ofDrawCircle(mouseCur, radius);
 		ofPopStyle();
+		ofDrawBitmapStringHighlight(ofToString(canvas.getStrokeCount()) + " strokes" +
+									(canvas.getPendingSaves() ? ", saving" : ""), 10, 20);
 	}
 	void mouseMoved(int x, int y) {
 		mouseCur.set(x - sw * screen, y);
 	}
 	void mouseDragged(int x, int y, int b) {
 		mouseCur.set(x - sw * screen, y);
+		canvas.addPoint(mouseCur);
 	}
 	void mousePressed(int x, int y, int b) {
-		mousePrev.set(x - sw * screen, y);
+		mouseCur.set(x - sw * screen, y);
+		// holding any key erases
+		canvas.beginStroke(mouseCur, radius, ofGetKeyPressed() ? 0 : 255);
 	}
 	void keyPressed(int key) {
 		if(key == '=') {
@@ -76,11 +61,19 @@ public:
 		if(key == '\t') {
 			screen = (screen + 1) % sc;
 		}
+		if(key == 'z' && canvas.undo()) {
+			save();
+		}
+		if(key == 'y' && canvas.redo()) {
+			save();
+		}
 	}
 	void mouseReleased(int x, int y, int b) {
-		ofPixels pix;
-		fbo.readToPixels(pix);
-		ofSaveImage(pix, "mask-" + ofToString(screen) + "-" + ofGetTimestampString() + ".png");
+		canvas.endStroke();
+		save();
+	}
+	void save() {
+		canvas.save("mask-" + ofToString(screen) + "-" + ofGetTimestampString() + ".png");
 	}
 };
 
@@ -1,5 +1,6 @@
 #include "ofMain.h"
 #include "ofxCv.h"
+#include "LightLeaksUtilities.h"
 
 using namespace cv;
 using namespace ofxCv;
@@ -13,114 +14,6 @@ void lookupCamPosition(ofShortImage& proMap,
     cy = camColor[1];
 }
 
-bool inside(const unsigned short& x,
-            const unsigned short& y,
-            const int& w,
-            const int& h) {
-    return x >= 0 && x < w && y >= 0 && y < h;
-}
-
-void buildProMapLerp(const Mat& binaryCoded,
-                     const Mat& camConfidence,
-                     Mat& proConfidence,
-                     Mat& proMap) {
-    proConfidence.setTo(0);
-    proMap.setTo(0);
-    
-    int ph = proConfidence.rows;
-    int pw = proConfidence.cols;
-    int ch = camConfidence.rows;
-    int cw = camConfidence.cols;
-    for(int cy = 0; cy < ch-1; cy++) {
-        for(int cx = 0; cx < cw-1; cx++) {
-            const float& c00conf = camConfidence.at<float>(cy, cx);
-            const Vec3w& c00map = binaryCoded.at<Vec3w>(cy, cx);
-            const unsigned short& p00x = c00map[0], p00y = c00map[1];
-            
-            const float& c10conf = camConfidence.at<float>(cy, cx+1);
-            const Vec3w& c10map = binaryCoded.at<Vec3w>(cy, cx+1);
-            const unsigned short& p10x = c10map[0], p10y = c10map[1];
-            
-            const float& c01conf = camConfidence.at<float>(cy+1, cx);
-            const Vec3w& c01map = binaryCoded.at<Vec3w>(cy+1, cx);
-            const unsigned short& p01x = c01map[0], p01y = c01map[1];
-            
-            if(inside(p00x, p00y, pw, ph)) {
-                if(inside(p10x, p10y, pw, ph)) {
-                    short dx = (short) p00x - (short) p10x;
-                    short dy = (short) p00y - (short) p10y;
-                }
-                if(inside(p01x, p01y, pw, ph)) {
-                    short dx = (short) p00x - (short) p01x;
-                    short dy = (short) p00y - (short) p01y;
-                }
-            }
-        }
-    }
-}
-
-void medianThreshold(cv::Mat& src, float thresholdValue) {
-    cv::Mat thresholded, filtered;
-    ofxCv::threshold(src, thresholded, thresholdValue);
-    ofxCv::medianBlur(thresholded, filtered, 3);
-    thresholded &= filtered;
-    min(src, thresholded, src);
-}
-
-void buildProMapDist(const Mat& binaryCodedIn,
-                     const Mat& camConfidenceIn,
-                     Mat& proConfidence,
-                     Mat& proMap,
-                     int k) {
-    Mat camConfidence;
-    Mat binaryCoded;
-    cv::blur(camConfidenceIn, camConfidence, cv::Size(k, k));
-    cv::blur(binaryCodedIn, binaryCoded, cv::Size(k, k));
-    
-    proConfidence.setTo(0);
-    proMap.setTo(0);
-    int n = 1 + k * 2;
-    Mat1f weights = Mat1f::zeros(n, n);
-    for(int y = 0; y < n; y++) {
-        for(int x = 0; x < n; x++) {
-            float dx = x - k, dy = y - k;
-            float distance = sqrtf(dx * dx + dy * dy);
-            weights(y, x) = (float) k / (k + distance); // falloff function
-        }
-    }
-    int ph = proConfidence.rows;
-    int pw = proConfidence.cols;
-    int ch = camConfidence.rows;
-    int cw = camConfidence.cols;
-    for(int cy = 0; cy < ch; cy++) {
-        for(int cx = 0; cx < cw; cx++) {
-            const float& cconf = camConfidence.at<float>(cy, cx);
-            const Vec3w& cmap = binaryCoded.at<Vec3w>(cy, cx);
-            int px = cmap[0], py = cmap[1];
-            if(px >= 0 && px < pw && py >= 0 && py < ph) {
-                for(int oy = -k; oy <= +k; oy++) {
-                    for(int ox = -k; ox <= +k; ox++) {
-                        int pox = px + ox, poy = py + oy;
-                        if(pox >= 0 && pox < pw && poy >= 0 && poy < ph) {
-                            int wx = ox + k, wy = oy + k;
-                            float& weight = weights(wy, wx);
-                            float& pconf = proConfidence.at<float>(poy, pox);
-                            float curconf = weight * cconf;
-                            if(curconf > pconf) {
-                                Vec3w& pmap = proMap.at<Vec3w>(poy, pox);
-                                pmap(0) = cx;
-                                pmap(1) = cy;
-                                pconf = curconf;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    medianThreshold(proConfidence, .25);
-}
-
 void buildProMapBlur(const Mat& binaryCodedIn,
                      const Mat& camConfidenceIn,
                      Mat& proConfidence,
@@ -159,6 +52,8 @@ void buildProMapBlur(const Mat& binaryCodedIn,
 class ofApp : public ofBaseApp {
 public:
     int ox, oy;
+    bool useMesh = true;
+    string scanPath;
     ofShortImage binaryCoded, proMap;
     ofFloatImage camConfidence, proConfidence;
     void setup() {
@@ -209,6 +104,10 @@ public:
         ox = 0, oy = 0;
     }
     void keyPressed(int key) {
+        if(key == 'm') {
+            useMesh = !useMesh;
+            loadScan(scanPath);
+        }
         if(key == OF_KEY_LEFT) {
             ox--;
         }
@@ -223,6 +122,7 @@ public:
         }
     }
     void loadScan(string path) {
+        scanPath = path;
         camConfidence.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
         proConfidence.getTexture().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
         camConfidence.load(path + "/camConfidence.exr");
@@ -230,12 +130,23 @@ public:
         
         int proWidth = 1920 * 3;
         int proHeight = 1200;
-        proConfidence.allocate(proWidth, proHeight, OF_IMAGE_GRAYSCALE);
-        proMap.allocate(proWidth, proHeight, OF_IMAGE_COLOR);
-        Mat proConfidenceMat = toCv(proConfidence);
-        Mat proMapMat = toCv(proMap);
-        buildProMapDist(toCv(binaryCoded), toCv(camConfidence),
-                        proConfidenceMat, proMapMat, 3);
+        Mat proConfidenceMat, proMapMat;
+        uint64_t start = ofGetElapsedTimeMillis();
+        if(useMesh) {
+            vector<Mat> channels;
+            split(toCv(binaryCoded), channels);
+            Mat coordX, coordY, proMapFine;
+            channels[0].convertTo(coordX, CV_32F);
+            channels[1].convertTo(coordY, CV_32F);
+            buildProMapMesh(proWidth, proHeight, coordX, coordY, toCv(camConfidence), .05, 4,
+                            proConfidenceMat, proMapMat, proMapFine);
+        } else {
+            buildProMapDist(proWidth, proHeight, toCv(binaryCoded), toCv(camConfidence),
+                            proConfidenceMat, proMapMat, 3);
+        }
+        ofLog() << (useMesh ? "buildProMapMesh" : "buildProMapDist") << " took " << (ofGetElapsedTimeMillis() - start) << "ms";
+        toOf(proConfidenceMat, proConfidence);
+        toOf(proMapMat, proMap);
         proConfidence.update();
         proMap.update();
         proConfidence.save("proConfidence.exr");
@@ -0,0 +1,567 @@
+#include "ofApp.h"
+
+#include "ofxProCamToolkit.h"
+#include "LightLeaksUtilities.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+const int scaleFactor = 4; // camera xyzMap downsampling, same as BuildXyzMap
+const float confidenceThreshold = 0.01; // same as BuildXyzMap
+
+int grayCode(int x) {
+	return (x >> 1) ^ x;
+}
+
+ofVec3f toVec3f(const ofJson& json) {
+	return ofVec3f(json[0], json[1], json[2]);
+}
+
+void getBoundingBox(const ofMesh& mesh, ofVec3f& min, ofVec3f& max) {
+	int n = mesh.getNumVertices();
+	if(n > 0) {
+		min = mesh.getVertex(0);
+		max = mesh.getVertex(0);
+		for(int i = 1; i < n; i++) {
+			const ofVec3f& cur = mesh.getVertices()[i];
+			min.x = MIN(min.x, cur.x);
+			min.y = MIN(min.y, cur.y);
+			min.z = MIN(min.z, cur.z);
+			max.x = MAX(max.x, cur.x);
+			max.y = MAX(max.y, cur.y);
+			max.z = MAX(max.z, cur.z);
+		}
+	}
+}
+
+double millisSince(uint64_t start) {
+	return (ofGetElapsedTimeMicros() - start) / 1000.;
+}
+
+// compares a proMap against the camera-space ground truth: every confident
+// projector pixel should point at a camera pixel that was lit by that same
+// projector pixel.
+ofJson proMapAccuracy(const Mat& proConfidence, const Mat& proMap, const Mat& groundTruthCode) {
+	int valid = 0, exact = 0, near = 0;
+	double totalError = 0;
+	Mat1b reachable = Mat1b::zeros(proMap.rows, proMap.cols);
+	for(int y = 0; y < groundTruthCode.rows; y++) {
+		for(int x = 0; x < groundTruthCode.cols; x++) {
+			const Vec3f& code = groundTruthCode.at<Vec3f>(y, x);
+			if(code[0] >= 0 && code[0] < proMap.cols && code[1] >= 0 && code[1] < proMap.rows) {
+				reachable(code[1], code[0]) = 255;
+			}
+		}
+	}
+	for(int py = 0; py < proMap.rows; py++) {
+		for(int px = 0; px < proMap.cols; px++) {
+			if(proConfidence.at<float>(py, px) > confidenceThreshold) {
+				const Vec3w& cam = proMap.at<Vec3w>(py, px);
+				const Vec3f& code = groundTruthCode.at<Vec3f>(cam[1], cam[0]);
+				if(code[0] < 0) {
+					continue;
+				}
+				float error = MAX(fabsf(code[0] - px), fabsf(code[1] - py));
+				totalError += error;
+				exact += error == 0;
+				near += error <= 1;
+				valid++;
+			}
+		}
+	}
+	ofJson result;
+	int total = countNonZero(reachable);
+	result["coverage"] = total ? (float) valid / total : 0;
+	result["exact"] = valid ? (float) exact / valid : 0;
+	result["withinOnePixel"] = valid ? (float) near / valid : 0;
+	result["meanError"] = valid ? totalError / valid : 0;
+	return result;
+}
+
+// mean distance between the merged xyz and the projector-space ground truth, in model units
+ofJson ofApp::xyzAccuracy(const Mat& confidenceCombined, const Mat& xyzCombined, const Mat& groundTruthXyz) {
+	int merged = 0;
+	double totalDistance = 0;
+	for(int y = 0; y < groundTruthXyz.rows; y++) {
+		for(int x = 0; x < groundTruthXyz.cols; x++) {
+			const Vec4f& truth = groundTruthXyz.at<Vec4f>(y, x);
+			if(confidenceCombined.at<float>(y, x) > 0 && truth[3] > 0) {
+				const Vec4f& cur = xyzCombined.at<Vec4f>(y, x);
+				Vec3f diff(cur[0] - truth[0], cur[1] - truth[1], cur[2] - truth[2]);
+				totalDistance += norm(diff) * range;
+				merged++;
+			}
+		}
+	}
+	ofJson result;
+	result["pixels"] = merged;
+	result["meanDistance"] = merged ? totalDistance / merged : 0;
+	return result;
+}
+
+void ofApp::setup() {
+	ofSetLogLevel(OF_LOG_VERBOSE);
+	ofSetVerticalSync(true);
+	ofSetFrameRate(60);
+
+	xyzShader.load("xyz.vs", "xyz.fs");
+
+	setCalibrationDataPathRoot();
+
+	settings = ofLoadJson("settings.json");
+	synthetic = ofLoadJson("synthetic.json");
+
+	proWidth = 0, proHeight = 0;
+	for(auto p : settings["projectors"]) {
+		proWidth = MAX(proWidth, int(p["width"]) + int(p["xcode"]));
+		proHeight = MAX(proHeight, int(p["height"]) + int(p["ycode"]));
+	}
+
+	model.loadModel("model.dae");
+	objectMesh = model.getMesh(0);
+
+	ofVec3f min, max;
+	getBoundingBox(objectMesh, min, max);
+	zero = min;
+	ofVec3f diagonal = max - min;
+	range = MAX(MAX(diagonal.x, diagonal.y), diagonal.z);
+	cout << "Using min " << min << " max " << max << " and range " << range << endl;
+}
+
+void ofApp::update() {
+}
+
+void ofApp::draw() {
+	ofBackground(30);
+	ofSetColor(255);
+	if(preview.isAllocated()) {
+		float scale = MIN(ofGetWidth() / preview.getWidth(), ofGetHeight() / preview.getHeight());
+		preview.draw(0, 0, preview.getWidth() * scale, preview.getHeight() * scale);
+	}
+	ofDrawBitmapStringHighlight("g - Generate synthetic scan", 10, 20);
+	ofDrawBitmapStringHighlight("b - Benchmark last scan (or drag a scan in)", 10, 40);
+	ofDrawBitmapStringHighlight(statusText, 10, 70);
+}
+
+void ofApp::keyPressed(int key) {
+	if(key == 'g') {
+		lastScan = generateScan();
+	}
+	if(key == 'b') {
+		if(lastScan.empty()) {
+			for(ofFile scan : getScanNames()) {
+				if(scan.isDirectory() && ofIsStringInString(scan.getFileName(), "scan-synthetic")) {
+					lastScan = scan.getFileName() + "/";
+				}
+			}
+		}
+		if(lastScan.empty()) {
+			ofLogError() << "No synthetic scan to benchmark, press g first";
+		} else {
+			benchmarkScan(lastScan);
+		}
+	}
+}
+
+void ofApp::dragged(ofDragInfo& drag) {
+	for(int i = 0; i < drag.files.size(); i++) {
+		benchmarkScan(drag.files[i] + "/");
+	}
+}
+
+// poses in synthetic.json are normalized to the model bounding box, like xyzMap
+void ofApp::setupView(ofCamera& view, const ofJson& config, int width, int height) {
+	view.setupPerspective(false, config["fov"], range * .01, range * 10);
+	view.setForceAspectRatio((float) width / height);
+	view.setPosition(toVec3f(config["position"]) * range + zero);
+	ofVec3f up = config.count("up") ? toVec3f(config["up"]) : ofVec3f(0, 1, 0);
+	view.lookAt(toVec3f(config["target"]) * range + zero, up);
+}
+
+// same normalized xyz that camamok renders, with alpha 0 where there is no model
+ofFloatPixels ofApp::renderXyz(ofCamera& view, int width, int height) {
+	ofFbo::Settings fboSettings;
+	fboSettings.width = width;
+	fboSettings.height = height;
+	fboSettings.useDepth = true;
+	fboSettings.numSamples = 1;
+	fboSettings.internalformat = GL_RGBA32F_ARB;
+
+	ofFbo fbo;
+	fbo.allocate(fboSettings);
+	fbo.begin(); {
+		ofClear(0, 0, 0, 0);
+		view.begin(ofRectangle(0, 0, width, height));
+		glEnable(GL_DEPTH_TEST);
+		xyzShader.begin();
+		xyzShader.setUniform1f("range", range);
+		xyzShader.setUniform3fv("zero", zero.getPtr());
+		objectMesh.drawFaces();
+		xyzShader.end();
+		glDisable(GL_DEPTH_TEST);
+		view.end();
+	} fbo.end();
+
+	ofFloatPixels pix;
+	fbo.readToPixels(pix);
+	return pix;
+}
+
+string ofApp::generateScan() {
+	ofJson cameraConfig = synthetic["camera"];
+	ofJson renderConfig = synthetic["render"];
+	int camWidth = cameraConfig["width"], camHeight = cameraConfig["height"];
+	float occlusionTolerance = renderConfig["occlusionTolerance"];
+	RNG rng(renderConfig["seed"].get<int>());
+
+	ofLogVerbose() << "rendering camera view " << camWidth << "x" << camHeight;
+	ofCamera camera;
+	setupView(camera, cameraConfig, camWidth, camHeight);
+	ofFloatPixels camXyz = renderXyz(camera, camWidth, camHeight);
+	const float* camXyzPixels = camXyz.getData();
+
+	// for every camera pixel find the global projector code that lights it,
+	// -1 where no projector reaches the surface. fineX and fineY are the sub-pixel
+	// projector coordinates (pixel x centered on x) for the phase patterns.
+	Mat1f codeX(camHeight, camWidth, -1.f), codeY(camHeight, camWidth, -1.f);
+	Mat1f fineX(camHeight, camWidth, -1.f), fineY(camHeight, camWidth, -1.f);
+	Mat4f proXyz = Mat4f::zeros(proHeight, proWidth);
+	int n = settings["projectors"].size();
+	for(int i = 0; i < n; i++) {
+		ofJson proSettings = settings["projectors"][i];
+		int width = proSettings["width"], height = proSettings["height"];
+		int xcode = proSettings["xcode"], ycode = proSettings["ycode"];
+
+		ofLogVerbose() << "rendering projector " << i << " " << width << "x" << height;
+		ofCamera projector;
+		setupView(projector, synthetic["projectors"][i], width, height);
+		ofFloatPixels proPixels = renderXyz(projector, width, height);
+		toCv(proPixels).copyTo(proXyz(cv::Rect(xcode, ycode, width, height)));
+
+		const float* proXyzPixels = proPixels.getData();
+		ofRectangle viewport(0, 0, width, height);
+		for(int y = 0; y < camHeight; y++) {
+			for(int x = 0; x < camWidth; x++) {
+				const float* xyz = &camXyzPixels[(y * camWidth + x) * 4];
+				if(xyz[3] == 0) {
+					continue;
+				}
+				ofVec3f world = ofVec3f(xyz[0], xyz[1], xyz[2]) * range + zero;
+				glm::vec3 screen = projector.worldToScreen(world, viewport);
+				int px = screen.x, py = screen.y;
+				if(px < 0 || px >= width || py < 0 || py >= height) {
+					continue;
+				}
+				// the surface is only lit if the projector sees this same point,
+				// otherwise it's in the shadow of something closer to the projector
+				const float* seen = &proXyzPixels[(py * width + px) * 4];
+				float dx = seen[0] - xyz[0], dy = seen[1] - xyz[1], dz = seen[2] - xyz[2];
+				if(seen[3] == 0 || dx * dx + dy * dy + dz * dz > occlusionTolerance * occlusionTolerance) {
+					continue;
+				}
+				codeX(y, x) = px + xcode;
+				codeY(y, x) = py + ycode;
+				fineX(y, x) = screen.x - .5 + xcode;
+				fineY(y, x) = screen.y - .5 + ycode;
+			}
+		}
+	}
+
+	string path = "scan-synthetic-" + ofGetTimestampString("%m%d-%H%M") + "/";
+	ofLogVerbose() << "writing " << path;
+
+	float ambient = renderConfig["ambient"];
+	float brightness = renderConfig["brightness"];
+	float noise = renderConfig["noise"];
+	float blur = renderConfig["blur"];
+	float misalignment = renderConfig["misalignment"];
+	int specularSpots = renderConfig["specularSpots"];
+	int specularRadius = renderConfig["specularRadius"];
+
+	// surfaces aren't evenly lit, so the decoder can't rely on a fixed threshold
+	Mat1f albedo(camHeight, camWidth);
+	rng.fill(albedo, RNG::UNIFORM, .5, 1);
+
+	// mirror ball reflections: small saturated spots that follow the pattern of
+	// some unrelated projector pixel, so they flicker through every level
+	vector<cv::Point> spotCenters;
+	vector<cv::Point> spotCodes;
+	for(int i = 0; i < specularSpots; i++) {
+		spotCenters.push_back(cv::Point(rng.uniform(0, camWidth), rng.uniform(0, camHeight)));
+		spotCodes.push_back(cv::Point(rng.uniform(0, proWidth), rng.uniform(0, proHeight)));
+	}
+
+	// blur, camera bumps and sensor noise, then save as a jpg like the real camera
+	auto capture = [&](Mat1f& image, string dir, string name) {
+		if(blur > 0) {
+			cv::GaussianBlur(image, image, cv::Size(), blur);
+		}
+		if(misalignment > 0) {
+			// the camera gets bumped a little between shots
+			Mat shift = (Mat_<double>(2, 3) <<
+						 1, 0, rng.uniform(-misalignment, misalignment),
+						 0, 1, rng.uniform(-misalignment, misalignment));
+			warpAffine(image, image, shift, image.size(), INTER_LINEAR, BORDER_REPLICATE);
+		}
+		if(noise > 0) {
+			Mat1f sensorNoise(image.size());
+			rng.fill(sensorNoise, RNG::NORMAL, 0, noise);
+			image += sensorNoise;
+		}
+		Mat image8;
+		image.convertTo(image8, CV_8U);
+		ofDirectory::createDirectory(dir, true, true);
+		saveImage(image8, dir + name + ".jpg", OF_IMAGE_QUALITY_HIGH);
+		return image8;
+	};
+
+	int levelsX = ceil(log2(proWidth)), levelsY = ceil(log2(proHeight));
+	for(int axis = 0; axis < 2; axis++) {
+		int levels = axis == 0 ? levelsX : levelsY;
+		const Mat1f& code = axis == 0 ? codeX : codeY;
+		string axisName = axis == 0 ? "vertical/" : "horizontal/";
+		for(int level = 0; level < levels; level++) {
+			for(int inverted : {0, 1}) {
+				Mat1f image(camHeight, camWidth, ambient);
+				for(int y = 0; y < camHeight; y++) {
+					for(int x = 0; x < camWidth; x++) {
+						float c = code(y, x);
+						if(c >= 0) {
+							int bit = ((grayCode(c) >> level) & 1) ^ inverted;
+							image(y, x) += bit * brightness * albedo(y, x);
+						}
+					}
+				}
+				for(int i = 0; i < specularSpots; i++) {
+					int spotCode = axis == 0 ? spotCodes[i].x : spotCodes[i].y;
+					if(((grayCode(spotCode) >> level) & 1) ^ inverted) {
+						circle(image, spotCenters[i], specularRadius, Scalar(255), -1);
+					}
+				}
+				// same naming as ProCamSample: files count down from the most significant bit, so the coarsest level is 0
+				string dir = path + "cameraImages/" + axisName + (inverted ? "inverse/" : "normal/");
+				Mat image8 = capture(image, dir, ofToString(levels - level - 1));
+				if(axis == 0 && level == levels - 1 && !inverted) {
+					toOf(image8, preview);
+					preview.update();
+				}
+			}
+		}
+	}
+
+	// phase shifted sinusoids, same as the ProCamSample shader
+	int phaseSteps = settings["sample"]["phaseSteps"];
+	int phasePeriod = settings["sample"]["phasePeriod"];
+	for(int axis = 0; axis < 2; axis++) {
+		const Mat1f& fine = axis == 0 ? fineX : fineY;
+		string axisName = axis == 0 ? "vertical/" : "horizontal/";
+		for(int phase = 0; phase < phaseSteps; phase++) {
+			Mat1f image(camHeight, camWidth, ambient);
+			for(int y = 0; y < camHeight; y++) {
+				for(int x = 0; x < camWidth; x++) {
+					float f = fine(y, x);
+					if(f >= 0) {
+						float angle = TWO_PI * ((f + .5) / phasePeriod + (float) phase / phaseSteps);
+						image(y, x) += (.5 + .5 * cosf(angle)) * brightness * albedo(y, x);
+					}
+				}
+			}
+			capture(image, path + "cameraImages/" + axisName + "phase/", ofToString(phase));
+		}
+	}
+
+	// camera space ground truth: the projector code per camera pixel
+	Mat groundTruthCode;
+	vector<Mat> channels = {codeX, codeY, Mat1f::zeros(camHeight, camWidth)};
+	merge(channels, groundTruthCode);
+	saveImage(groundTruthCode, path + "_groundTruthCode.exr");
+
+	// projector space ground truth: what BuildXyzMap should end up with
+	saveImage(proXyz, path + "_groundTruthXyz.exr");
+
+	// the xyzMap camamok would have produced, downsampled like BuildXyzMap expects
+	Mat xyzMap;
+	cv::resize(toCv(camXyz), xyzMap, cv::Size(camWidth / scaleFactor, camHeight / scaleFactor), 0, 0, INTER_NEAREST);
+	saveImage(xyzMap, path + "xyzMap.exr");
+
+	statusText = "Generated " + path;
+	return path;
+}
+
+// decodes, builds and merges the scan at several camera resolutions, timing each
+// stage and checking the results against the ground truth from generateScan()
+void ofApp::benchmarkScan(string path) {
+	ofFloatImage groundTruthCodeImage, groundTruthXyzImage, xyzMapImage;
+	groundTruthCodeImage.setUseTexture(false);
+	groundTruthXyzImage.setUseTexture(false);
+	xyzMapImage.setUseTexture(false);
+	if(!groundTruthCodeImage.load(path + "_groundTruthCode.exr") ||
+	   !groundTruthXyzImage.load(path + "_groundTruthXyz.exr") ||
+	   !xyzMapImage.load(path + "xyzMap.exr")) {
+		ofLogError() << path << " is missing ground truth, only synthetic scans can be benchmarked";
+		return;
+	}
+	Mat groundTruthCodeFull = toCv(groundTruthCodeImage);
+	Mat groundTruthXyz = toCv(groundTruthXyzImage);
+	Mat xyzMap = toCv(xyzMapImage);
+
+	vector<ofFile> files[2][2], phaseFiles[2];
+	string axisNames[] = {"vertical/", "horizontal/"};
+	for(int axis = 0; axis < 2; axis++) {
+		ofDirectory dirNormal(path + "cameraImages/" + axisNames[axis] + "normal/");
+		ofDirectory dirInverse(path + "cameraImages/" + axisNames[axis] + "inverse/");
+		dirNormal.listDir();
+		dirInverse.listDir();
+		files[axis][0] = dirNormal.getFiles();
+		files[axis][1] = dirInverse.getFiles();
+		ofSort(files[axis][0], natural);
+		ofSort(files[axis][1], natural);
+		ofDirectory dirPhase(path + "cameraImages/" + axisNames[axis] + "phase/");
+		if(dirPhase.exists()) {
+			dirPhase.listDir();
+			phaseFiles[axis] = dirPhase.getFiles();
+			ofSort(phaseFiles[axis], natural);
+		}
+	}
+	int phasePeriod = settings["sample"]["phasePeriod"];
+	float phaseMinModulation = settings["sample"]["phaseMinModulation"];
+
+	ofJson results;
+	for(float scale : synthetic["benchmark"]["scales"]) {
+		ofJson result;
+		result["scale"] = scale;
+
+		uint64_t start = ofGetElapsedTimeMicros();
+		auto load = [&](ofFile& file) {
+			ofImage full, scaled;
+			full.setUseTexture(false);
+			scaled.setUseTexture(false);
+			full.load(file.path());
+			full.setImageType(OF_IMAGE_GRAYSCALE);
+			ofxCv::resize(full, scaled, scale, scale, INTER_AREA);
+			return scaled;
+		};
+		vector<ofImage> images[2][2];
+		vector<Mat> phaseImages[2];
+		for(int axis = 0; axis < 2; axis++) {
+			for(int inverted = 0; inverted < 2; inverted++) {
+				for(ofFile& file : files[axis][inverted]) {
+					images[axis][inverted].push_back(load(file));
+				}
+			}
+			for(ofFile& file : phaseFiles[axis]) {
+				phaseImages[axis].push_back(toCv(load(file)).clone());
+			}
+		}
+		result["loadMs"] = millisSince(start);
+
+		int camWidth = images[0][0][0].getWidth(), camHeight = images[0][0][0].getHeight();
+		result["camWidth"] = camWidth;
+		result["camHeight"] = camHeight;
+
+		// ProCamScan decode, minus the per image highpass and alignment
+		start = ofGetElapsedTimeMicros();
+		Mat camConfidence = Mat::zeros(camHeight, camWidth, CV_32FC1);
+		Mat binaryCodedAxis[2], minImage, maxImage;
+		int bits = 0;
+		for(int axis = 0; axis < 2; axis++) {
+			int n = images[axis][0].size();
+			binaryCodedAxis[axis] = Mat::zeros(camHeight, camWidth, CV_16UC1);
+			for(int i = 0; i < n; i++) {
+				processGraycodeLevel(i, n, 2, camConfidence, binaryCodedAxis[axis], minImage, maxImage,
+									 &images[axis][0][i], &images[axis][1][i]);
+			}
+			grayToBinary(binaryCodedAxis[axis], n);
+			bits += n;
+		}
+		camConfidence /= 255 * bits;
+		result["decodeMs"] = millisSince(start);
+
+		Mat groundTruthCode;
+		cv::resize(groundTruthCodeFull, groundTruthCode, cv::Size(camWidth, camHeight), 0, 0, INTER_NEAREST);
+		int lit = 0, exact = 0, near = 0;
+		for(int y = 0; y < camHeight; y++) {
+			for(int x = 0; x < camWidth; x++) {
+				const Vec3f& code = groundTruthCode.at<Vec3f>(y, x);
+				if(code[0] >= 0) {
+					float dx = fabsf(binaryCodedAxis[0].at<unsigned short>(y, x) - code[0]);
+					float dy = fabsf(binaryCodedAxis[1].at<unsigned short>(y, x) - code[1]);
+					exact += MAX(dx, dy) == 0;
+					near += MAX(dx, dy) <= 1;
+					lit++;
+				}
+			}
+		}
+		result["decode"]["exact"] = lit ? (float) exact / lit : 0;
+		result["decode"]["withinOnePixel"] = lit ? (float) near / lit : 0;
+
+		Mat binaryCoded;
+		vector<Mat> channels = {binaryCodedAxis[0], binaryCodedAxis[1], Mat::zeros(camHeight, camWidth, CV_16UC1)};
+		merge(channels, binaryCoded);
+
+		Mat proConfidence, proMap;
+		start = ofGetElapsedTimeMicros();
+		buildProMap(proWidth, proHeight, binaryCoded, camConfidence, proConfidence, proMap);
+		result["proMapMs"] = millisSince(start);
+		result["proMap"] = proMapAccuracy(proConfidence, proMap, groundTruthCode);
+
+		start = ofGetElapsedTimeMicros();
+		buildProMapDist(proWidth, proHeight, binaryCoded, camConfidence, proConfidence, proMap, 3);
+		result["proMapDistMs"] = millisSince(start);
+		result["proMapDist"] = proMapAccuracy(proConfidence, proMap, groundTruthCode);
+
+		{
+			Mat meshConfidence, meshMap, meshMapFine, coordX, coordY;
+			start = ofGetElapsedTimeMicros();
+			binaryCodedAxis[0].convertTo(coordX, CV_32F);
+			binaryCodedAxis[1].convertTo(coordY, CV_32F);
+			buildProMapMesh(proWidth, proHeight, coordX, coordY, camConfidence, .05, 4,
+							meshConfidence, meshMap, meshMapFine);
+			result["proMapMeshMs"] = millisSince(start);
+			result["proMapMesh"] = proMapAccuracy(meshConfidence, meshMap, groundTruthCode);
+		}
+
+		// the xyzMap is stored at full resolution / scaleFactor
+		int xyzScaleFactor = MAX(1, (int) roundf(scaleFactor * scale));
+		Mat xyzCombined = Mat::zeros(proHeight, proWidth, CV_32FC4);
+		Mat confidenceCombined = Mat::zeros(proHeight, proWidth, CV_32FC1);
+		Mat distCombined = Mat::zeros(proHeight, proWidth, CV_32FC1);
+		Mat updated;
+		start = ofGetElapsedTimeMicros();
+		Mat proXyz = sampleXyzMap(proMap, Mat(), xyzMap, xyzScaleFactor);
+		mergeScanXyz(proConfidence, proXyz,
+					 confidenceThreshold, 1,
+					 range, zero,
+					 xyzCombined, confidenceCombined, distCombined,
+					 updated);
+		result["mergeMs"] = millisSince(start);
+		result["merge"] = xyzAccuracy(confidenceCombined, xyzCombined, groundTruthXyz);
+
+		if(!phaseImages[0].empty() && !phaseImages[1].empty()) {
+			// same merge, but through the phase refined float proMap
+			start = ofGetElapsedTimeMicros();
+			Mat refinedX, refinedY, modulation, proMapFine;
+			phaseRefine(phaseImages[0], binaryCodedAxis[0], phasePeriod, phaseMinModulation, refinedX, modulation);
+			phaseRefine(phaseImages[1], binaryCodedAxis[1], phasePeriod, phaseMinModulation, refinedY, modulation);
+			refineProMap(proConfidence, proMap, refinedX, refinedY, proMapFine);
+			result["phaseMs"] = millisSince(start);
+
+			xyzCombined.setTo(0);
+			confidenceCombined.setTo(0);
+			distCombined.setTo(0);
+			proXyz = sampleXyzMap(proMap, proMapFine, xyzMap, xyzScaleFactor);
+			mergeScanXyz(proConfidence, proXyz,
+						 confidenceThreshold, 1,
+						 range, zero,
+						 xyzCombined, confidenceCombined, distCombined,
+						 updated);
+			result["mergePhase"] = xyzAccuracy(confidenceCombined, xyzCombined, groundTruthXyz);
+		}
+
+		ofLogNotice() << result.dump(1);
+		results.push_back(result);
+	}
+
+	ofSavePrettyJson(path + "_benchmark.json", results);
+	statusText = "Benchmarked " + path + "\n" + results.dump(1);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCv.h"
+#include "ofxAssimpModelLoader.h"
+
+// renders gray code scans of model.dae from a virtual camera and projectors
+// described in synthetic.json, then times ProCamScan decode, proMap building and
+// the BuildXyzMap merge against the known ground truth.
+class ofApp : public ofBaseApp {
+public:
+	void setup();
+	void update();
+	void draw();
+	void keyPressed(int key);
+	void dragged(ofDragInfo& drag);
+
+	void setupView(ofCamera& view, const ofJson& config, int width, int height);
+	ofFloatPixels renderXyz(ofCamera& view, int width, int height);
+	string generateScan();
+	void benchmarkScan(string path);
+	ofJson xyzAccuracy(const cv::Mat& confidenceCombined, const cv::Mat& xyzCombined, const cv::Mat& groundTruthXyz);
+
+	ofJson settings, synthetic;
+	int proWidth, proHeight;
+
+	ofxAssimpModelLoader model;
+	ofVboMesh objectMesh;
+	ofShader xyzShader;
+	float range;
+	ofVec3f zero;
+
+	string lastScan;
+	string statusText;
+	ofImage preview;
+};
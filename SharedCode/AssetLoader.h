@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ofMain.h"
+#include <condition_variable>
+#include <future>
+#include <queue>
+
+// decodes images on a pool of threads so several files load at once, and keeps
+// how long each one took. only pixels come back, uploading is left to whoever
+// owns the gl context. freeimage decodes one exr on one thread, so the speedup
+// comes from loading files side by side rather than from splitting a file.
+class AssetLoader {
+public:
+    AssetLoader(int threads = 0)
+    :stopping(false)
+    ,start(ofGetElapsedTimeMicros()) {
+        // freeimage sets itself up on the first load and that isn't thread
+        // safe, so get it out of the way on this thread
+        ofLogLevel level = ofGetLogLevel("ofImage");
+        ofSetLogLevel("ofImage", OF_LOG_SILENT);
+        ofPixels dummy;
+        ofLoadImage(dummy, ofBuffer());
+        ofSetLogLevel("ofImage", level);
+
+        if(threads <= 0) {
+            // at least two so reading one file overlaps decoding another
+            threads = MAX(2, (int) std::thread::hardware_concurrency());
+        }
+        for(int i = 0; i < threads; i++) {
+            workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+    ~AssetLoader() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // the pixels are empty if the file can't be read
+    std::future<ofFloatPixels> loadFloat(string filename) {
+        return load<float>(filename);
+    }
+    std::future<ofShortPixels> loadShort(string filename) {
+        return load<unsigned short>(filename);
+    }
+    std::future<ofPixels> loadBytes(string filename) {
+        return load<unsigned char>(filename);
+    }
+
+    // one line per file in the order they finished, with the decode time and
+    // when it finished since the loader was created
+    string getReport() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return report.str();
+    }
+
+protected:
+    template <class T>
+    std::future<ofPixels_<T>> load(string filename) {
+        auto task = std::make_shared<std::packaged_task<ofPixels_<T>()>>([this, filename]() {
+            uint64_t begin = ofGetElapsedTimeMicros();
+            ofPixels_<T> pixels;
+            if(!ofLoadImage(pixels, filename)) {
+                ofLogWarning("AssetLoader") << "can't load " << filename;
+            }
+            uint64_t end = ofGetElapsedTimeMicros();
+            std::unique_lock<std::mutex> lock(mutex);
+            report << ofFilePath::getFileName(filename) << " " << (end - begin) / 1000 << "ms, done at "
+                << (end - start) / 1000 << "ms" << endl;
+            return pixels;
+        });
+        std::future<ofPixels_<T>> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs.push([task]() {
+                (*task)();
+            });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    void work() {
+        while(true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() {
+                    return stopping || !jobs.empty();
+                });
+                if(jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::queue<std::function<void()>> jobs;
+    vector<std::thread> workers;
+    bool stopping;
+    uint64_t start;
+    std::stringstream report;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "ofxCv.h"
+#include "Parallel.h"
+#include "CalibrationMetrics.h"
+#include "ConnectedComponents.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+// builds the projector masks from the unmasked proConfidence of several scans instead of
+// painting them in Debug-MaskBuilder. a projector pixel is kept when enough scans
+// saw it, then the coverage is closed and opened to get rid of gaps and speckles,
+// small islands are dropped, small holes filled, and the edge pulled in by a
+// margin and feathered so the blend between projectors is soft. the masks are
+// written in the usual names, mask-N.png per projector and mask.png over all of
+// them, and can still be touched up by hand afterwards.
+
+struct AutoMaskSettings {
+    float confidenceThreshold = 0.05;
+    int minScans = 1; // how many scans need to see a pixel
+    int closeSize = 9, openSize = 5; // morphology kernel diameters, 0 to skip
+    int minArea = 2000; // smaller islands are dropped
+    int maxHoleArea = 5000; // smaller holes are filled
+    float margin = 4, feather = 16; // in projector pixels
+};
+
+AutoMaskSettings getAutoMaskSettings(const ofJson& json) {
+    AutoMaskSettings settings;
+    if(json.count("confidenceThreshold")) settings.confidenceThreshold = json["confidenceThreshold"];
+    if(json.count("minScans")) settings.minScans = json["minScans"];
+    if(json.count("closeSize")) settings.closeSize = json["closeSize"];
+    if(json.count("openSize")) settings.openSize = json["openSize"];
+    if(json.count("minArea")) settings.minArea = json["minArea"];
+    if(json.count("maxHoleArea")) settings.maxHoleArea = json["maxHoleArea"];
+    if(json.count("margin")) settings.margin = json["margin"];
+    if(json.count("feather")) settings.feather = json["feather"];
+    return settings;
+}
+
+// 255 where at least minScans of the CV_32FC1 confidence maps are over threshold
+Mat1b buildMaskCoverage(const vector<Mat>& confidences, float threshold, int minScans) {
+    Mat1b count;
+    for(const Mat& confidence : confidences) {
+        if(count.empty()) {
+            count = Mat1b::zeros(confidence.size());
+        }
+        // compare gives 255 where it holds
+        Mat1b seen = confidence > threshold;
+        cv::add(count, seen / 255, count);
+    }
+    if(count.empty()) {
+        return count;
+    }
+    return count >= MIN(minScans, (int) confidences.size());
+}
+
+// drops connected regions of mask smaller than minArea, in place
+void removeSmallComponents(Mat1b& mask, int minArea) {
+    ConnectedComponents components;
+    components.label(mask.ptr(), mask.cols, mask.rows, mask.step);
+    components.fillMask(mask.ptr(), mask.step, minArea);
+}
+
+// fills holes smaller than maxArea in place. background that reaches the edge
+// is outside the projector rather than a hole, so it stays
+void fillSmallHoles(Mat1b& mask, int maxArea) {
+    Mat1b holes = mask == 0;
+    ConnectedComponents components;
+    components.label(holes.ptr(), holes.cols, holes.rows, holes.step);
+    vector<bool> fill(components.size());
+    for(int i = 0; i < components.size(); i++) {
+        fill[i] = components.getArea(i) < maxArea && !components.touchesEdge(i);
+    }
+    components.fillMask(holes.ptr(), holes.step, fill);
+    mask |= holes;
+}
+
+// the soft mask for one projector from its part of the coverage
+Mat1b buildProjectorMask(const Mat1b& coverage, const AutoMaskSettings& settings) {
+    Mat1b mask = coverage.clone();
+    if(settings.closeSize > 0) {
+        Mat kernel = getStructuringElement(MORPH_ELLIPSE, cv::Size(settings.closeSize, settings.closeSize));
+        morphologyEx(mask, mask, MORPH_CLOSE, kernel);
+    }
+    if(settings.openSize > 0) {
+        Mat kernel = getStructuringElement(MORPH_ELLIPSE, cv::Size(settings.openSize, settings.openSize));
+        morphologyEx(mask, mask, MORPH_OPEN, kernel);
+    }
+    if(settings.minArea > 0) {
+        removeSmallComponents(mask, settings.minArea);
+    }
+    if(settings.maxHoleArea > 0) {
+        fillSmallHoles(mask, settings.maxHoleArea);
+    }
+
+    // distance to the nearest unmasked (zero) pixel, ramped from the margin to margin + feather.
+    // the border is padded with black so the edge of the projector fades too
+    Mat1b padded;
+    copyMakeBorder(mask, padded, 1, 1, 1, 1, BORDER_CONSTANT, Scalar(0));
+    Mat1f distance;
+    distanceTransform(padded, distance, DIST_L2, DIST_MASK_PRECISE);
+    distance = distance(cv::Rect(1, 1, mask.cols, mask.rows));
+    float feather = MAX(settings.feather, 1);
+    Mat1b soft;
+    distance.convertTo(soft, CV_8U, 255 / feather, -255 * settings.margin / feather);
+    return soft;
+}
+
+// one mask per projector region and all of them in the combined raster, the
+// projectors are built in parallel
+vector<Mat1b> buildAutoMasks(const vector<Mat>& confidences, const vector<ProjectorRegion>& regions,
+                             const AutoMaskSettings& settings, Mat1b& combined) {
+    vector<Mat1b> masks(regions.size());
+    Mat1b coverage = buildMaskCoverage(confidences, settings.confidenceThreshold, settings.minScans);
+    if(coverage.empty()) {
+        return masks;
+    }
+    combined = Mat1b::zeros(coverage.size());
+    parallelFor(regions.size(), [&](int i) {
+        cv::Rect rect = regions[i].rect & cv::Rect(0, 0, coverage.cols, coverage.rows);
+        // projectors that reach past the scans are black there
+        masks[i] = Mat1b::zeros(regions[i].rect.size());
+        if(rect.area() == 0) {
+            return;
+        }
+        Mat1b mask = buildProjectorMask(coverage(rect), settings);
+        mask.copyTo(masks[i](cv::Rect(rect.tl() - regions[i].rect.tl(), rect.size())));
+        // regions don't overlap, so the projectors can write side by side
+        mask.copyTo(combined(rect));
+    });
+    return masks;
+}
+
+// mask-N.png and mask.png in path
+void saveAutoMasks(const vector<Mat1b>& masks, const Mat1b& combined, string path) {
+    for(int i = 0; i < masks.size(); i++) {
+        saveImage(masks[i], path + "/mask-" + ofToString(i) + ".png");
+    }
+    saveImage(combined, path + "/mask.png");
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include "ofxCv.h"
+#include "Parallel.h"
+#include "opencv2/core/hal/intrin.hpp"
+
+using namespace ofxCv;
+using namespace cv;
+
+// numbers for how good a scan is, per projector, so a calibration can be judged
+// without eyeballing Debug-Correlation or the _debug.png overlay:
+// - coverage: fraction of projector pixels with confidence over the threshold
+// - a histogram of the confidence of those pixels
+// - duplication: confident projector pixels that share their camera pixel with
+//   another projector pixel, from the same or another projector
+// - nonmatch: how much the camera confidence at the camera pixel a projector
+//   pixel maps to differs from the projector confidence, like Debug-Correlation
+// - reprojection error, when a residual map from the stereo calibration is given
+// everything is computed on strips of rows in parallel. saveCalibrationMetrics
+// writes _metrics.json and one heatmap per metric next to the scan.
+
+const int metricsHistogramBins = 20;
+const int metricsStripRows = 16;
+
+struct ProjectorRegion {
+    int index;
+    cv::Rect rect; // in the combined projector raster, from xcode, ycode, width and height
+};
+
+struct ProjectorMetrics {
+    int index = 0;
+    int pixels = 0, confident = 0, duplicated = 0;
+    float coverage = 0, duplication = 0;
+    float meanConfidence = 0;
+    vector<int> histogram = vector<int>(metricsHistogramBins, 0);
+    float meanNonmatch = 0, p95Nonmatch = 0; // 0-1
+    bool hasReprojection = false;
+    float meanReprojection = 0, p95Reprojection = 0; // projector pixels
+};
+
+struct CalibrationMetrics {
+    vector<ProjectorMetrics> projectors;
+    Mat nonmatch; // CV_8UC1, 0-255
+    Mat duplication; // CV_8UC1, how many projector pixels share each pixel's camera pixel
+    Mat confidence, residuals; // references to the inputs for the heatmaps
+    float confidenceThreshold = 0;
+};
+
+vector<ProjectorRegion> getProjectorRegions(const ofJson& settings) {
+    vector<ProjectorRegion> regions;
+    int i = 0;
+    for(auto p : settings["projectors"]) {
+        regions.push_back({i++, cv::Rect(p["xcode"], p["ycode"], p["width"], p["height"])});
+    }
+    return regions;
+}
+
+// |camConfidence at the camera pixel each projector pixel maps to - proConfidence|
+// as 0-255. the lookup into the camera is a scalar gather, the rest is simd.
+void computeNonmatch(const Mat& proConfidence, const Mat& proMap, const Mat& camConfidence, Mat& nonmatch) {
+    int rows = proConfidence.rows, cols = proConfidence.cols;
+    int camWidth = camConfidence.cols, camHeight = camConfidence.rows;
+    nonmatch.create(rows, cols, CV_8UC1);
+    int strips = (rows + metricsStripRows - 1) / metricsStripRows;
+    parallelFor(strips, [&](int strip) {
+        vector<float> gathered(cols);
+        int end = MIN(rows, (strip + 1) * metricsStripRows);
+        for(int y = strip * metricsStripRows; y < end; y++) {
+            const Vec3w* camXy = proMap.ptr<Vec3w>(y);
+            for(int x = 0; x < cols; x++) {
+                int cx = MIN(camXy[x][0], camWidth - 1);
+                int cy = MIN(camXy[x][1], camHeight - 1);
+                gathered[x] = camConfidence.at<float>(cy, cx);
+            }
+            const float* pro = proConfidence.ptr<float>(y);
+            unsigned char* out = nonmatch.ptr<unsigned char>(y);
+            int x = 0;
+#if CV_SIMD128
+            v_float32x4 scale = v_setall_f32(255);
+            for(; x + 16 <= cols; x += 16) {
+                v_int32x4 d0 = v_trunc(v_absdiff(v_load(&gathered[x]), v_load(pro + x)) * scale);
+                v_int32x4 d1 = v_trunc(v_absdiff(v_load(&gathered[x + 4]), v_load(pro + x + 4)) * scale);
+                v_int32x4 d2 = v_trunc(v_absdiff(v_load(&gathered[x + 8]), v_load(pro + x + 8)) * scale);
+                v_int32x4 d3 = v_trunc(v_absdiff(v_load(&gathered[x + 12]), v_load(pro + x + 12)) * scale);
+                v_store(out + x, v_pack_u(v_pack(d0, d1), v_pack(d2, d3)));
+            }
+#endif
+            for(; x < cols; x++) {
+                out[x] = saturate_cast<unsigned char>((int) (255 * fabsf(gathered[x] - pro[x])));
+            }
+        }
+    });
+}
+
+// bin at fraction p of a histogram
+float histogramPercentile(const vector<int>& counts, int total, float p) {
+    int target = p * total, sum = 0;
+    for(int i = 0; i < counts.size(); i++) {
+        sum += counts[i];
+        if(sum > target) {
+            return i;
+        }
+    }
+    return counts.size() - 1;
+}
+
+// proConfidence is CV_32FC1 and proMap CV_16UC3 over the combined projector raster,
+// camConfidence CV_32FC1 in camera pixels, residuals CV_32FC1 in projector pixels.
+// proMap, camConfidence and residuals can be empty to skip the metrics that need them.
+CalibrationMetrics computeCalibrationMetrics(const Mat& proConfidence, const Mat& proMap, const Mat& camConfidence,
+                                             const Mat& residuals, const vector<ProjectorRegion>& regions,
+                                             float confidenceThreshold) {
+    CalibrationMetrics metrics;
+    metrics.confidence = proConfidence;
+    metrics.residuals = residuals;
+    metrics.confidenceThreshold = confidenceThreshold;
+    int rows = proConfidence.rows, cols = proConfidence.cols;
+
+    if(!camConfidence.empty() && !proMap.empty()) {
+        computeNonmatch(proConfidence, proMap, camConfidence, metrics.nonmatch);
+    }
+
+    // scattering into the camera would race, so the counts are built on one thread.
+    // it's one increment per confident pixel, the reductions below are the slow part
+    Mat1w camCount;
+    int camWidth = 0, camHeight = 0;
+    if(!proMap.empty()) {
+        if(!camConfidence.empty()) {
+            camWidth = camConfidence.cols;
+            camHeight = camConfidence.rows;
+        } else {
+            for(int y = 0; y < rows; y++) {
+                const Vec3w* camXy = proMap.ptr<Vec3w>(y);
+                for(int x = 0; x < cols; x++) {
+                    camWidth = MAX(camWidth, camXy[x][0] + 1);
+                    camHeight = MAX(camHeight, camXy[x][1] + 1);
+                }
+            }
+        }
+        camCount = Mat1w::zeros(camHeight, camWidth);
+        for(int y = 0; y < rows; y++) {
+            const float* confidence = proConfidence.ptr<float>(y);
+            const Vec3w* camXy = proMap.ptr<Vec3w>(y);
+            for(int x = 0; x < cols; x++) {
+                if(confidence[x] > confidenceThreshold) {
+                    unsigned short& count = camCount(MIN(camXy[x][1], camHeight - 1), MIN(camXy[x][0], camWidth - 1));
+                    count = MIN(count + 1, 65535);
+                }
+            }
+        }
+        metrics.duplication = Mat::zeros(rows, cols, CV_8UC1);
+    }
+
+    for(const ProjectorRegion& region : regions) {
+        cv::Rect rect = region.rect & cv::Rect(0, 0, cols, rows);
+        ProjectorMetrics result;
+        result.index = region.index;
+        result.pixels = rect.area();
+
+        // per strip partial sums, merged after
+        int strips = (rect.height + metricsStripRows - 1) / metricsStripRows;
+        struct Partial {
+            int confident = 0, duplicated = 0, reprojected = 0;
+            double confidenceSum = 0, nonmatchSum = 0, reprojectionSum = 0;
+            vector<int> histogram = vector<int>(metricsHistogramBins, 0);
+            vector<int> nonmatchCounts = vector<int>(256, 0);
+            vector<int> reprojectionCounts = vector<int>(256, 0); // tenths of a pixel
+        };
+        vector<Partial> partials(strips);
+        parallelFor(strips, [&](int strip) {
+            Partial& partial = partials[strip];
+            int begin = rect.y + strip * metricsStripRows;
+            int end = MIN(rect.y + rect.height, begin + metricsStripRows);
+            for(int y = begin; y < end; y++) {
+                const float* confidence = proConfidence.ptr<float>(y);
+                const Vec3w* camXy = proMap.empty() ? NULL : proMap.ptr<Vec3w>(y);
+                const unsigned char* nonmatch = metrics.nonmatch.empty() ? NULL : metrics.nonmatch.ptr<unsigned char>(y);
+                const float* residual = residuals.empty() ? NULL : residuals.ptr<float>(y);
+                unsigned char* duplication = metrics.duplication.empty() ? NULL : metrics.duplication.ptr<unsigned char>(y);
+                for(int x = rect.x; x < rect.x + rect.width; x++) {
+                    float c = confidence[x];
+                    if(c <= confidenceThreshold) {
+                        continue;
+                    }
+                    partial.confident++;
+                    partial.confidenceSum += c;
+                    partial.histogram[MIN((int) (c * metricsHistogramBins), metricsHistogramBins - 1)]++;
+                    if(camXy) {
+                        int count = camCount(MIN(camXy[x][1], camHeight - 1), MIN(camXy[x][0], camWidth - 1));
+                        duplication[x] = MIN(count, 255);
+                        if(count > 1) {
+                            partial.duplicated++;
+                        }
+                    }
+                    if(nonmatch) {
+                        partial.nonmatchSum += nonmatch[x];
+                        partial.nonmatchCounts[nonmatch[x]]++;
+                    }
+                    if(residual && residual[x] > 0) {
+                        partial.reprojected++;
+                        partial.reprojectionSum += residual[x];
+                        partial.reprojectionCounts[MIN((int) (residual[x] * 10), 255)]++;
+                    }
+                }
+            }
+        });
+
+        Partial total;
+        for(const Partial& partial : partials) {
+            total.confident += partial.confident;
+            total.duplicated += partial.duplicated;
+            total.reprojected += partial.reprojected;
+            total.confidenceSum += partial.confidenceSum;
+            total.nonmatchSum += partial.nonmatchSum;
+            total.reprojectionSum += partial.reprojectionSum;
+            for(int i = 0; i < metricsHistogramBins; i++) total.histogram[i] += partial.histogram[i];
+            for(int i = 0; i < 256; i++) total.nonmatchCounts[i] += partial.nonmatchCounts[i];
+            for(int i = 0; i < 256; i++) total.reprojectionCounts[i] += partial.reprojectionCounts[i];
+        }
+        result.confident = total.confident;
+        result.duplicated = total.duplicated;
+        result.histogram = total.histogram;
+        if(result.pixels > 0) {
+            result.coverage = (float) total.confident / result.pixels;
+        }
+        if(total.confident > 0) {
+            result.duplication = (float) total.duplicated / total.confident;
+            result.meanConfidence = total.confidenceSum / total.confident;
+            if(!metrics.nonmatch.empty()) {
+                result.meanNonmatch = total.nonmatchSum / total.confident / 255;
+                result.p95Nonmatch = histogramPercentile(total.nonmatchCounts, total.confident, .95) / 255;
+            }
+        }
+        if(total.reprojected > 0) {
+            result.hasReprojection = true;
+            result.meanReprojection = total.reprojectionSum / total.reprojected;
+            result.p95Reprojection = histogramPercentile(total.reprojectionCounts, total.reprojected, .95) / 10;
+        }
+        metrics.projectors.push_back(result);
+    }
+    return metrics;
+}
+
+ofJson getMetricsJson(const CalibrationMetrics& metrics) {
+    ofJson json;
+    json["confidenceThreshold"] = metrics.confidenceThreshold;
+    for(const ProjectorMetrics& p : metrics.projectors) {
+        ofJson cur;
+        cur["index"] = p.index;
+        cur["pixels"] = p.pixels;
+        cur["confident"] = p.confident;
+        cur["coverage"] = p.coverage;
+        cur["meanConfidence"] = p.meanConfidence;
+        cur["confidenceHistogram"] = p.histogram;
+        if(!metrics.duplication.empty()) {
+            cur["duplicated"] = p.duplicated;
+            cur["duplication"] = p.duplication;
+        }
+        if(!metrics.nonmatch.empty()) {
+            cur["meanNonmatch"] = p.meanNonmatch;
+            cur["p95Nonmatch"] = p.p95Nonmatch;
+        }
+        if(p.hasReprojection) {
+            cur["meanReprojection"] = p.meanReprojection;
+            cur["p95Reprojection"] = p.p95Reprojection;
+        }
+        json["projectors"].push_back(cur);
+    }
+    return json;
+}
+
+// values from 0 to maxValue as a color map, black where the projector isn't confident
+Mat metricsHeatmap(const Mat& values, float maxValue, const Mat& confidence, float confidenceThreshold) {
+    Mat scaled, colored;
+    values.convertTo(scaled, CV_8U, 255. / maxValue);
+    applyColorMap(scaled, colored, COLORMAP_JET);
+    // the color map is bgr, saveImage writes rgb
+    cvtColor(colored, colored, COLOR_BGR2RGB);
+    Mat mask = confidence <= confidenceThreshold;
+    colored.setTo(Scalar::all(0), mask);
+    return colored;
+}
+
+// _metrics.json, _metricsConfidence.png and, when they were computed,
+// _metricsDuplication.png, _metricsNonmatch.png and _metricsReprojection.png in path
+void saveCalibrationMetrics(const CalibrationMetrics& metrics, string path) {
+    ofSavePrettyJson(path + "/_metrics.json", getMetricsJson(metrics));
+    float threshold = metrics.confidenceThreshold;
+    saveImage(metricsHeatmap(metrics.confidence, 1, metrics.confidence, threshold), path + "/_metricsConfidence.png");
+    if(!metrics.duplication.empty()) {
+        saveImage(metricsHeatmap(metrics.duplication, 4, metrics.confidence, threshold), path + "/_metricsDuplication.png");
+    }
+    if(!metrics.nonmatch.empty()) {
+        saveImage(metricsHeatmap(metrics.nonmatch, 255, metrics.confidence, threshold), path + "/_metricsNonmatch.png");
+    }
+    if(!metrics.residuals.empty()) {
+        saveImage(metricsHeatmap(metrics.residuals, 4, metrics.confidence, threshold), path + "/_metricsReprojection.png");
+    }
+}
+
+// checks every projector against the "metrics" limits in settings.json, any of
+// minCoverage, maxDuplication, maxNonmatch and maxReprojection. failures get one
+// line each, for gating a deployment on the numbers.
+bool checkCalibrationMetrics(const CalibrationMetrics& metrics, const ofJson& limits, string& failures) {
+    failures = "";
+    for(const ProjectorMetrics& p : metrics.projectors) {
+        string name = "projector " + ofToString(p.index);
+        if(limits.count("minCoverage") && p.coverage < float(limits["minCoverage"])) {
+            failures += name + " coverage " + ofToString(p.coverage, 3) + "\n";
+        }
+        if(limits.count("maxDuplication") && !metrics.duplication.empty() && p.duplication > float(limits["maxDuplication"])) {
+            failures += name + " duplication " + ofToString(p.duplication, 3) + "\n";
+        }
+        if(limits.count("maxNonmatch") && !metrics.nonmatch.empty() && p.meanNonmatch > float(limits["maxNonmatch"])) {
+            failures += name + " nonmatch " + ofToString(p.meanNonmatch, 3) + "\n";
+        }
+        if(limits.count("maxReprojection") && p.hasReprojection && p.p95Reprojection > float(limits["maxReprojection"])) {
+            failures += name + " reprojection p95 " + ofToString(p.p95Reprojection, 2) + "px\n";
+        }
+    }
+    return failures.empty();
+}
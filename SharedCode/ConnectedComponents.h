@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "Parallel.h"
+
+// 8 connected components of a binary image, found on runs of foreground pixels
+// rather than pixel by pixel. strips of rows are labeled in parallel, each with
+// union-find over its own runs, and a merge step joins runs across the strip
+// edges. islands are then dropped by area with fillMask. only depends on
+// Parallel.h, callers pass pointers into an ofPixels or cv::Mat.
+class ConnectedComponents {
+public:
+    // foreground is nonzero where a pixel belongs to some component, stride in bytes
+    void label(const uint8_t* foreground, int width, int height, size_t stride, int stripRows = 64) {
+        this->width = width;
+        this->height = height;
+        this->stripRows = stripRows;
+        int strips = (height + stripRows - 1) / stripRows;
+
+        // runs of each strip, found in parallel
+        std::vector<std::vector<Run>> stripRuns(strips);
+        rowStart.assign(height + 1, 0);
+        parallelFor(strips, [&](int strip) {
+            int end = std::min(height, (strip + 1) * stripRows);
+            for(int y = strip * stripRows; y < end; y++) {
+                const uint8_t* row = foreground + y * stride;
+                int count = 0;
+                for(int x = 0; x < width;) {
+                    if(!row[x]) {
+                        x++;
+                        continue;
+                    }
+                    int x0 = x;
+                    while(x < width && row[x]) {
+                        x++;
+                    }
+                    stripRuns[strip].push_back({x0, x, 0});
+                    count++;
+                }
+                rowStart[y + 1] = count;
+            }
+        });
+        for(int y = 0; y < height; y++) {
+            rowStart[y + 1] += rowStart[y];
+        }
+        runs.resize(rowStart[height]);
+        for(int strip = 0; strip < strips; strip++) {
+            std::copy(stripRuns[strip].begin(), stripRuns[strip].end(), runs.begin() + rowStart[strip * stripRows]);
+        }
+
+        // every run starts as its own set. inside a strip only that strip's runs
+        // are linked, so strips don't touch each other's parents
+        parent.resize(runs.size());
+        for(int i = 0; i < parent.size(); i++) {
+            parent[i] = i;
+        }
+        parallelFor(strips, [&](int strip) {
+            int end = std::min(height, (strip + 1) * stripRows);
+            for(int y = strip * stripRows + 1; y < end; y++) {
+                joinRows(y);
+            }
+        });
+        // the merge step, the first row of each strip with the last of the one above
+        for(int strip = 1; strip < strips; strip++) {
+            joinRows(strip * stripRows);
+        }
+
+        // number the roots and add up their areas
+        std::vector<int> component(runs.size(), -1);
+        areas.clear();
+        edges.clear();
+        for(int y = 0; y < height; y++) {
+            for(int i = rowStart[y]; i < rowStart[y + 1]; i++) {
+                int root = find(i);
+                if(component[root] < 0) {
+                    component[root] = areas.size();
+                    areas.push_back(0);
+                    edges.push_back(false);
+                }
+                Run& run = runs[i];
+                run.component = component[root];
+                areas[run.component] += run.x1 - run.x0;
+                if(y == 0 || y + 1 == height || run.x0 == 0 || run.x1 == width) {
+                    edges[run.component] = true;
+                }
+            }
+        }
+    }
+
+    int size() const {
+        return areas.size();
+    }
+    int getArea(int component) const {
+        return areas[component];
+    }
+    // whether the component reaches the edge of the image
+    bool touchesEdge(int component) const {
+        return edges[component];
+    }
+    // foreground pixels in components smaller than minArea
+    int countSmall(int minArea) const {
+        int count = 0;
+        for(int area : areas) {
+            if(area < minArea) {
+                count += area;
+            }
+        }
+        return count;
+    }
+
+    // 255 for pixels of components with at least minArea, 0 everywhere else.
+    // out is width by height with stride bytes per row
+    void fillMask(uint8_t* out, size_t stride, int minArea) const {
+        std::vector<bool> keep(areas.size());
+        for(int i = 0; i < areas.size(); i++) {
+            keep[i] = areas[i] >= minArea;
+        }
+        fillMask(out, stride, keep);
+    }
+    // 255 for pixels of the components where keep is true
+    void fillMask(uint8_t* out, size_t stride, const std::vector<bool>& keep) const {
+        int strips = (height + stripRows - 1) / stripRows;
+        parallelFor(strips, [&](int strip) {
+            int end = std::min(height, (strip + 1) * stripRows);
+            for(int y = strip * stripRows; y < end; y++) {
+                uint8_t* row = out + y * stride;
+                memset(row, 0, width);
+                for(int i = rowStart[y]; i < rowStart[y + 1]; i++) {
+                    const Run& run = runs[i];
+                    if(keep[run.component]) {
+                        memset(row + run.x0, 255, run.x1 - run.x0);
+                    }
+                }
+            }
+        });
+    }
+
+protected:
+    struct Run {
+        int x0, x1; // x1 is one past the end
+        int component;
+    };
+
+    int find(int i) {
+        while(parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+    void join(int a, int b) {
+        a = find(a);
+        b = find(b);
+        // the lower run stays the root so the labels don't depend on the order
+        if(a < b) {
+            parent[b] = a;
+        } else if(b < a) {
+            parent[a] = b;
+        }
+    }
+    // links the runs of row y with the runs of row y - 1 they touch, diagonals included
+    void joinRows(int y) {
+        int i = rowStart[y - 1], iEnd = rowStart[y];
+        int j = rowStart[y], jEnd = rowStart[y + 1];
+        while(i < iEnd && j < jEnd) {
+            const Run& above = runs[i];
+            const Run& below = runs[j];
+            if(above.x0 <= below.x1 && below.x0 <= above.x1) {
+                join(i, j);
+            }
+            // move past whichever run ends first
+            if(above.x1 < below.x1) {
+                i++;
+            } else {
+                j++;
+            }
+        }
+    }
+
+    int width = 0, height = 0, stripRows = 64;
+    std::vector<Run> runs;
+    std::vector<int> rowStart; // runs of row y are rowStart[y] until rowStart[y + 1]
+    std::vector<int> parent;
+    std::vector<int> areas;
+    std::vector<bool> edges;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// layout of the shared memory ring LightLeaks publishes its output into, and a
+// reader for it. only depends on posix so monitoring tools, recorders and the
+// dashboard can include it without openFrameworks.
+//
+// the memory is a FrameExportHeader followed by slotCount slots, each a
+// FrameExportSlot followed by width * height * 4 bytes of rgba. the writer never
+// waits for readers: a slot's sequence is odd while it is being written, and a
+// reader that sees it change while copying just tries again.
+
+const uint32_t frameExportMagic = 0x4c4c4658; // "LLFX"
+const uint32_t frameExportVersion = 1;
+
+struct FrameExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height, channels;
+    uint32_t slotCount;
+    uint64_t slotSize; // bytes from one slot to the next, including its FrameExportSlot
+    std::atomic<uint64_t> published; // frames written so far, the latest is in slot (published - 1) % slotCount
+};
+
+// the show state that goes with a frame
+struct FrameExportState {
+    uint64_t frame;
+    double time; // seconds since the show started
+    int32_t stage, substage;
+    float stageAmp;
+    float lighthouseAngle;
+    int32_t spotlightCount;
+    float spotlights[8][3];
+};
+
+struct FrameExportSlot {
+    std::atomic<uint64_t> sequence;
+    FrameExportState state;
+};
+
+inline size_t getFrameExportSize(uint32_t width, uint32_t height, uint32_t slotCount, uint64_t& slotSize) {
+    // keep every image 64 byte aligned
+    slotSize = (sizeof(FrameExportSlot) + width * height * 4 + 63) & ~uint64_t(63);
+    size_t headerSize = (sizeof(FrameExportHeader) + 63) & ~size_t(63);
+    return headerSize + slotSize * slotCount;
+}
+
+inline FrameExportSlot* getFrameExportSlot(FrameExportHeader* header, uint32_t i) {
+    size_t headerSize = (sizeof(FrameExportHeader) + 63) & ~size_t(63);
+    return (FrameExportSlot*) ((uint8_t*) header + headerSize + header->slotSize * i);
+}
+
+inline uint8_t* getFrameExportPixels(FrameExportSlot* slot) {
+    return (uint8_t*) (slot + 1);
+}
+
+class FrameExportReader {
+public:
+    FrameExportReader()
+    :header(NULL)
+    ,size(0)
+    ,lastFrame(0) {
+    }
+    ~FrameExportReader() {
+        close();
+    }
+
+    // name is the same one given to the writer, like "/lightleaks"
+    bool open(std::string name) {
+        close();
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) < 0 || info.st_size < (off_t) sizeof(FrameExportHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void* memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(memory == MAP_FAILED) {
+            return false;
+        }
+        header = (FrameExportHeader*) memory;
+        size = info.st_size;
+        uint64_t slotSize;
+        if(header->magic != frameExportMagic ||
+           header->version != frameExportVersion ||
+           getFrameExportSize(header->width, header->height, header->slotCount, slotSize) > size) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    void close() {
+        if(header) {
+            munmap(header, size);
+            header = NULL;
+        }
+    }
+    bool isOpen() const {
+        return header != NULL;
+    }
+    int getWidth() const {
+        return header ? header->width : 0;
+    }
+    int getHeight() const {
+        return header ? header->height : 0;
+    }
+
+    // copies the newest frame into pixels (rgba, width * height * 4) and its
+    // state. returns false when there is nothing newer than the last call.
+    bool readLatest(std::vector<uint8_t>& pixels, FrameExportState& state) {
+        if(!header) {
+            return false;
+        }
+        size_t imageSize = (size_t) header->width * header->height * 4;
+        pixels.resize(imageSize);
+        for(int attempt = 0; attempt < 4; attempt++) {
+            uint64_t published = header->published.load(std::memory_order_acquire);
+            if(published == 0 || published == lastFrame) {
+                return false;
+            }
+            FrameExportSlot* slot = getFrameExportSlot(header, (published - 1) % header->slotCount);
+            uint64_t before = slot->sequence.load(std::memory_order_acquire);
+            if(before & 1) {
+                continue;
+            }
+            memcpy(&state, &slot->state, sizeof(state));
+            memcpy(pixels.data(), getFrameExportPixels(slot), imageSize);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(slot->sequence.load(std::memory_order_relaxed) == before) {
+                lastFrame = published;
+                return true;
+            }
+        }
+        // the writer lapped us every time, the next call will catch up
+        return false;
+    }
+
+protected:
+    FrameExportHeader* header;
+    size_t size;
+    uint64_t lastFrame;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ofxCv.h"
+#include "Parallel.h"
 
 using namespace ofxCv;
 using namespace cv;
@@ -14,6 +15,55 @@ void medianThreshold(cv::Mat& src, float thresholdValue) {
 }
 
 
+// sorts numbered files like 2.jpg before 10.jpg
+bool natural(const ofFile& a, const ofFile& b) {
+	string aname = a.getBaseName(), bname = b.getBaseName();
+	int aint = ofToInt(aname), bint = ofToInt(bname);
+	if(ofToString(aint) == aname && ofToString(bint) == bname) {
+		return aint < bint;
+	} else {
+		return a < b;
+	}
+}
+
+void processGraycodeLevel(int i, int n, int dimensions, Mat& confidence, Mat& binaryCoded, Mat& minMat, Mat& maxMat, ofImage * imageNormal, ofImage * imageInverse) {
+    ofLogVerbose() << "Process " << i << " of " << n;
+    
+	int w = imageNormal->getWidth(), h = imageNormal->getHeight();
+	cv::Mat imageNormalGray, imageInverseGray;
+    imageNormalGray = toCv(*imageNormal);
+    imageInverseGray = toCv(*imageInverse);
+    
+    
+	if(i == 0) {
+		minMat = min(imageNormalGray, imageInverseGray);
+		maxMat = max(imageNormalGray, imageInverseGray);
+	} else {
+		min(minMat, imageNormalGray, minMat);
+		min(minMat, imageInverseGray, minMat);
+		max(maxMat, imageNormalGray, maxMat);
+		max(maxMat, imageInverseGray, maxMat);
+	}
+    
+    unsigned short curMask = 1 << (n - i - 1);
+	for(int y = 0; y < h; y++) {
+		for(int x = 0; x < w; x++) {
+			const unsigned char& normal = imageNormalGray.at<unsigned char>(y, x);
+			const unsigned char& inverse = imageInverseGray.at<unsigned char>(y, x);
+			if(normal > inverse) {
+				binaryCoded.at<unsigned short>(y, x) |= curMask;
+			}
+			float range = fabsf((float) normal - (float) inverse);
+            confidence.at<float>(y, x) += range;
+		}
+    }
+    
+//    saveImage(imageNormalGray, "normal-gray-" + ofToString(i) + ".jpg");
+//    saveImage(imageInverseGray, "inverse-gray-" + ofToString(i) + ".jpg");
+//    saveImage(confidence, "confidence-" + ofToString(i) + ".exr");
+//    cout << "cur variation: " << curVariation << endl;
+}
+
 void buildProMapDist(int pw, int ph,
                      const Mat& binaryCodedIn,
                      const Mat& camConfidenceIn,
@@ -95,6 +145,341 @@ void buildProMap(int proWidth, int proHeight,
 //    medianThreshold(proConfidence, .25);
 }
 
+// one corner of a camera-space triangle, placed at its decoded projector position
+struct ProMapVertex {
+    float px, py;
+    float cx, cy;
+    float confidence;
+};
+
+// rasterizes one triangle into rows [y0, y1) of the projector maps, interpolating the
+// camera position and confidence at every projector pixel center it covers. pixels
+// that are already covered by something more confident are left alone.
+void rasterizeProMapTriangle(const ProMapVertex& a, const ProMapVertex& b, const ProMapVertex& c,
+                             int y0, int y1,
+                             Mat& proConfidence, Mat& proMap, Mat& proMapFine) {
+    float area = (b.px - a.px) * (c.py - a.py) - (c.px - a.px) * (b.py - a.py);
+    if(fabsf(area) < 1e-6) {
+        return;
+    }
+    const float epsilon = 1e-4;
+    int pw = proMap.cols;
+    int minX = MAX(0, (int) ceilf(MIN(a.px, MIN(b.px, c.px)) - epsilon));
+    int maxX = MIN(pw - 1, (int) floorf(MAX(a.px, MAX(b.px, c.px)) + epsilon));
+    int minY = MAX(y0, (int) ceilf(MIN(a.py, MIN(b.py, c.py)) - epsilon));
+    int maxY = MIN(y1 - 1, (int) floorf(MAX(a.py, MAX(b.py, c.py)) + epsilon));
+    for(int y = minY; y <= maxY; y++) {
+        float* confidenceRow = proConfidence.ptr<float>(y);
+        Vec3w* proMapRow = proMap.ptr<Vec3w>(y);
+        Vec3f* proMapFineRow = proMapFine.ptr<Vec3f>(y);
+        for(int x = minX; x <= maxX; x++) {
+            float wa = ((b.px - x) * (c.py - y) - (c.px - x) * (b.py - y)) / area;
+            float wb = ((c.px - x) * (a.py - y) - (a.px - x) * (c.py - y)) / area;
+            float wc = 1 - wa - wb;
+            if(wa < -epsilon || wb < -epsilon || wc < -epsilon) {
+                continue;
+            }
+            float confidence = wa * a.confidence + wb * b.confidence + wc * c.confidence;
+            if(confidence > confidenceRow[x]) {
+                float cx = wa * a.cx + wb * b.cx + wc * c.cx;
+                float cy = wa * a.cy + wb * b.cy + wc * c.cy;
+                confidenceRow[x] = confidence;
+                proMapFineRow[x] = Vec3f(cx, cy, 0);
+                proMapRow[x] = Vec3w((unsigned short) (cx + .5), (unsigned short) (cy + .5), 0);
+            }
+        }
+    }
+}
+
+// builds the proMap in projector space instead of splatting camera pixels into it:
+// every 2x2 block of camera pixels is two triangles at their decoded projector
+// positions, which are rasterized with barycentric interpolation of the camera
+// position and confidence. this fills the gaps that buildProMap leaves wherever the
+// camera undersamples the projector. triangles with a corner below minConfidence, or
+// an edge longer than maxEdge projector pixels (depth discontinuities and decoding
+// errors) are skipped, and overlaps resolve to the most confident like buildProMap.
+// coordX and coordY are CV_32F projector coordinates for each camera pixel, either
+// the gray code or phaseRefine output. proMapFine gets the sub-pixel camera position.
+void buildProMapMesh(int pw, int ph,
+                     const Mat& coordX, const Mat& coordY,
+                     const Mat& camConfidence,
+                     float minConfidence, float maxEdge,
+                     Mat& proConfidence, Mat& proMap, Mat& proMapFine) {
+    proMap = Mat::zeros(ph, pw, CV_16UC3);
+    proMapFine = Mat::zeros(ph, pw, CV_32FC3);
+    proConfidence = Mat::zeros(ph, pw, CV_32FC1);
+    int cw = camConfidence.cols, ch = camConfidence.rows;
+    
+    // the corners of the 2x2 block at cx, cy, corners 0 1 on top, 2 3 below.
+    // false when one of them isn't confident enough
+    auto loadCorners = [&](int cx, int cy, ProMapVertex* corners) {
+        for(int i = 0; i < 4; i++) {
+            int x = cx + (i & 1), y = cy + (i >> 1);
+            ProMapVertex& corner = corners[i];
+            corner.confidence = camConfidence.at<float>(y, x);
+            corner.px = coordX.at<float>(y, x);
+            corner.py = coordY.at<float>(y, x);
+            corner.cx = x, corner.cy = y;
+            if(corner.confidence <= minConfidence) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto triangleValid = [&](const ProMapVertex* corners, int a, int b, int c) {
+        auto edge = [&](int i, int j) {
+            return MAX(fabsf(corners[i].px - corners[j].px), fabsf(corners[i].py - corners[j].py)) <= maxEdge;
+        };
+        return edge(a, b) && edge(b, c) && edge(c, a);
+    };
+    const int triangles[2][3] = {{0, 1, 2}, {1, 3, 2}};
+    
+    // projector rows touched by the triangles between camera rows cy and cy + 1,
+    // so each band below only visits the camera rows that can reach it. only the
+    // triangles that get rasterized count, a stray decoding error would otherwise
+    // stretch the range over the whole projector
+    vector<float> rowMin(ch, FLT_MAX), rowMax(ch, -FLT_MAX);
+    parallelFor(ch - 1, [&](int cy) {
+        ProMapVertex corners[4];
+        for(int cx = 0; cx < cw - 1; cx++) {
+            if(!loadCorners(cx, cy, corners)) {
+                continue;
+            }
+            for(const int* t : triangles) {
+                if(triangleValid(corners, t[0], t[1], t[2])) {
+                    for(int i = 0; i < 3; i++) {
+                        rowMin[cy] = MIN(rowMin[cy], corners[t[i]].py);
+                        rowMax[cy] = MAX(rowMax[cy], corners[t[i]].py);
+                    }
+                }
+            }
+        }
+    });
+    
+    // every band owns its projector rows, so no two threads write the same pixel
+    int bandHeight = 32;
+    int bands = (ph + bandHeight - 1) / bandHeight;
+    parallelFor(bands, [&](int band) {
+        int y0 = band * bandHeight, y1 = MIN(ph, y0 + bandHeight);
+        ProMapVertex corners[4];
+        for(int cy = 0; cy < ch - 1; cy++) {
+            if(rowMax[cy] < y0 - 1 || rowMin[cy] > y1) {
+                continue;
+            }
+            for(int cx = 0; cx < cw - 1; cx++) {
+                if(!loadCorners(cx, cy, corners)) {
+                    continue;
+                }
+                for(const int* t : triangles) {
+                    if(triangleValid(corners, t[0], t[1], t[2])) {
+                        rasterizeProMapTriangle(corners[t[0]], corners[t[1]], corners[t[2]], y0, y1, proConfidence, proMap, proMapFine);
+                    }
+                }
+            }
+        }
+    });
+}
+
+// decodes N phase shifted sinusoids (captured at shifts 0..N-1 of one period) and
+// uses them to refine the integer gray code coordinates to sub-pixel precision.
+// refined uses the same convention as binaryCoded (pixel x is centered on x).
+// pixels with less than minModulation of sinusoid amplitude, or where the phase
+// disagrees with the gray code by more than a pixel, keep the gray code value.
+void phaseRefine(const vector<Mat>& phaseImages, const Mat& binaryCoded, int period, float minModulation,
+                 Mat& refined, Mat& modulation) {
+    int n = phaseImages.size();
+    Mat c = Mat::zeros(binaryCoded.size(), CV_32FC1);
+    Mat s = Mat::zeros(binaryCoded.size(), CV_32FC1);
+    Mat cur;
+    for(int k = 0; k < n; k++) {
+        phaseImages[k].convertTo(cur, CV_32F);
+        float delta = TWO_PI * k / n;
+        scaleAdd(cur, cosf(delta), c, c);
+        scaleAdd(cur, -sinf(delta), s, s);
+    }
+    Mat angle;
+    cv::phase(c, s, angle);
+    cv::magnitude(c, s, modulation);
+    modulation *= 2. / n;
+    
+    binaryCoded.convertTo(refined, CV_32F);
+    int m = refined.total();
+    const float* anglePixels = angle.ptr<float>();
+    const float* modulationPixels = modulation.ptr<float>();
+    float* refinedPixels = refined.ptr<float>();
+    float scale = period / TWO_PI;
+    for(int i = 0; i < m; i++) {
+        float coarse = refinedPixels[i];
+        // the pattern is centered on x + .5, and we only know it modulo the period
+        float fine = anglePixels[i] * scale - .5;
+        // unwrap to the period closest to the gray code
+        fine += period * floorf((coarse - fine) / period + .5);
+        bool valid = modulationPixels[i] > minModulation && fabsf(fine - coarse) <= 1;
+        refinedPixels[i] = valid ? fine : coarse;
+    }
+}
+
+// finds the sub-pixel camera position of every projector pixel center, starting from
+// the integer camera pixel in proMap. a 3x3 neighborhood of refined projector
+// coordinates around that camera pixel gives a local affine map from camera to
+// projector, which is inverted to find the offset. returns a CV_32FC3 (cx, cy, 0)
+// that equals proMap wherever the neighborhood is incomplete or discontinuous.
+void refineProMap(const Mat& proConfidence, const Mat& proMap,
+                  const Mat& refinedX, const Mat& refinedY,
+                  Mat& proMapFine) {
+    int pw = proMap.cols, ph = proMap.rows;
+    int cw = refinedX.cols, ch = refinedX.rows;
+    proMap.convertTo(proMapFine, CV_32F);
+    for(int py = 0; py < ph; py++) {
+        for(int px = 0; px < pw; px++) {
+            if(proConfidence.at<float>(py, px) == 0) {
+                continue;
+            }
+            const Vec3w& cur = proMap.at<Vec3w>(py, px);
+            int cx = cur[0], cy = cur[1];
+            if(cx < 1 || cy < 1 || cx >= cw - 1 || cy >= ch - 1) {
+                continue;
+            }
+            // least squares fit of u = a0 dx + a1 dy + a2 (and v likewise) over a full
+            // 3x3 grid, where the normal equations are diagonal
+            float u0 = refinedX.at<float>(cy, cx), v0 = refinedY.at<float>(cy, cx);
+            float su[3] = {0, 0, 0}, sv[3] = {0, 0, 0};
+            bool continuous = true;
+            for(int dy = -1; dy <= 1 && continuous; dy++) {
+                for(int dx = -1; dx <= 1; dx++) {
+                    float u = refinedX.at<float>(cy + dy, cx + dx) - u0;
+                    float v = refinedY.at<float>(cy + dy, cx + dx) - v0;
+                    if(fabsf(u) > 2 || fabsf(v) > 2) {
+                        continuous = false;
+                        break;
+                    }
+                    su[0] += dx * u, su[1] += dy * u, su[2] += u;
+                    sv[0] += dx * v, sv[1] += dy * v, sv[2] += v;
+                }
+            }
+            if(!continuous) {
+                continue;
+            }
+            float a0 = su[0] / 6, a1 = su[1] / 6, a2 = su[2] / 9;
+            float b0 = sv[0] / 6, b1 = sv[1] / 6, b2 = sv[2] / 9;
+            float det = a0 * b1 - a1 * b0;
+            if(fabsf(det) < 1e-4) {
+                continue;
+            }
+            float tu = px - u0 - a2, tv = py - v0 - b2;
+            float ox = (b1 * tu - a1 * tv) / det;
+            float oy = (a0 * tv - b0 * tu) / det;
+            if(fabsf(ox) < 2 && fabsf(oy) < 2) {
+                Vec3f& fine = proMapFine.at<Vec3f>(py, px);
+                fine[0] = cx + ox;
+                fine[1] = cy + oy;
+            }
+        }
+    }
+}
+
+// looks up the camera-space xyzMap (sampled at 1/scaleFactor) for every projector
+// pixel. with a proMapFine from phase refinement the lookup is bilinear, except
+// along silhouettes where it would blend with the empty background and the
+// nearest sample is used instead.
+Mat sampleXyzMap(const Mat& proMap, const Mat& proMapFine, const Mat& xyzMap, int scaleFactor) {
+    int w = proMap.cols, h = proMap.rows;
+    Mat proXyz(h, w, CV_32FC4);
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            const Vec3w& cur = proMap.at<Vec3w>(y, x);
+            proXyz.at<Vec4f>(y, x) = xyzMap.at<Vec4f>(cur[1] / scaleFactor, cur[0] / scaleFactor);
+        }
+    }
+    if(!proMapFine.empty()) {
+        Mat mapX, mapY, bilinear;
+        vector<Mat> channels;
+        split(proMapFine, channels);
+        // camera pixel c is centered on c, xyzMap pixel i covers camera [i * s, (i + 1) * s)
+        float offset = .5 / scaleFactor - .5;
+        channels[0].convertTo(mapX, CV_32F, 1. / scaleFactor, offset);
+        channels[1].convertTo(mapY, CV_32F, 1. / scaleFactor, offset);
+        remap(xyzMap, bilinear, mapX, mapY, INTER_LINEAR, BORDER_REPLICATE);
+        for(int y = 0; y < h; y++) {
+            for(int x = 0; x < w; x++) {
+                const Vec4f& cur = bilinear.at<Vec4f>(y, x);
+                if(cur[3] == 1) {
+                    proXyz.at<Vec4f>(y, x) = cur;
+                }
+            }
+        }
+    }
+    return proXyz;
+}
+
+// merges one scan into the combined projector-space maps, given the scan's xyz for
+// each projector pixel from sampleXyzMap. a projector pixel takes this scan's xyz
+// when it is closer to the scan's confidence-weighted mean point than whatever was
+// merged there before. `updated` is 255 wherever that happened.
+ofVec3f mergeScanXyz(const Mat& proConfidence, const Mat& proXyz,
+                     float confidenceThreshold, float confidenceMultiplier,
+                     float range, ofVec3f zero,
+                     Mat& xyzCombined, Mat& confidenceCombined, Mat& distCombined,
+                     Mat& updated) {
+    int w = proXyz.cols, h = proXyz.rows;
+    updated = Mat::zeros(h, w, CV_8UC1);
+    
+    // loop through once to compute the mean xyz points weighted by confidence
+    ofVec3f pointSum;
+    float pointWeights = 0;
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            const float& curConfidence = proConfidence.at<float>(y, x);
+            if(curConfidence > confidenceThreshold) {
+                const Vec4f& xyzNorm = proXyz.at<Vec4f>(y, x);
+                ofVec3f xyz(xyzNorm[0], xyzNorm[1], xyzNorm[2]);
+                xyz = xyz * range + zero;
+                pointSum += xyz * curConfidence;
+                pointWeights += curConfidence;
+            }
+        }
+    }
+    ofVec3f pointMean = pointSum / pointWeights;
+    
+    // loop through again to compute distances from the mean
+    Mat dist = Mat::zeros(h, w, CV_32FC1);
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            const float& curConfidence = proConfidence.at<float>(y, x);
+            if(curConfidence > confidenceThreshold) {
+                const Vec4f& xyzNorm = proXyz.at<Vec4f>(y, x);
+                ofVec3f xyz(xyzNorm[0], xyzNorm[1], xyzNorm[2]);
+                xyz = xyz * range + zero;
+                dist.at<float>(y, x) = xyz.distance(pointMean);
+            }
+        }
+    }
+    
+    // resolve these confidences and distances relative to all the others
+    for(int y = 0; y < h; y++) {
+        for(int x = 0; x < w; x++) {
+            float curConfidence = proConfidence.at<float>(y, x) * confidenceMultiplier;
+            if(curConfidence > confidenceThreshold) {
+                const float& curDist = dist.at<float>(y, x);
+                const Vec4f& xyzNorm = proXyz.at<Vec4f>(y, x);
+                
+                float& combinedConfidence = confidenceCombined.at<float>(y, x);
+                float& combinedDist = distCombined.at<float>(y, x);
+                
+                // one way to rectify this is to only use a pixel if the confidence is also better
+                // within a threshold than the previous confidence
+                if(combinedDist == 0 || (curDist > 0 && curDist < combinedDist)) {
+                    combinedDist = curDist;
+                    combinedConfidence = curConfidence;
+                    xyzCombined.at<Vec4f>(y, x) = xyzNorm;
+                    updated.at<unsigned char>(y, x) = 255;
+                }
+            }
+        }
+    }
+    return pointMean;
+}
+
 void setCalibrationDataPathRoot() {
     ofSetDataPathRoot(ofToDataPath("") + "/../../../SharedData");
     return ;
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#endif
+
+// runs fn(0) .. fn(n - 1) across all cores and returns when they are done.
+// on OS X this is the same dispatch_apply on the global queue that the USE_GDC
+// code uses, elsewhere it falls back to one std::thread per core.
+inline void parallelFor(int n, const std::function<void(int)>& fn) {
+#ifdef __APPLE__
+    const std::function<void(int)>* fnPtr = &fn;
+    dispatch_apply(n, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^(size_t i) {
+        (*fnPtr)(i);
+    });
+#else
+    int threads = std::min(n, (int) std::max(1u, std::thread::hardware_concurrency()));
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            for(int i = next++; i < n; i = next++) {
+                fn(i);
+            }
+        });
+    }
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+#endif
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include "ofxCv.h"
+#include "ofxProCamToolkit.h"
+#include "Parallel.h"
+
+using namespace ofxCv;
+using namespace cv;
+
+// calibrates the camera and every projector directly from the decoded proMaps of
+// several scans, treating each projector as a second camera, and triangulates the
+// correspondences into an xyzMap without needing a model.dae.
+
+// everything one scan knows about one projector
+struct StereoPair {
+    int scan, projector;
+    // all confident correspondences, proPoints are relative to the projector
+    vector<Point2f> camPoints, proPoints;
+    vector<cv::Point> proPixels; // position in the combined projector raster
+    vector<float> confidence;
+    // the projector pose relative to this scan's camera, like an rvec and tvec
+    Mat rotation, translation;
+    // triangulated in this scan's camera space
+    vector<Point3f> positions;
+    vector<float> residuals;
+};
+
+struct StereoIntrinsics {
+    Mat cameraMatrix, distCoeffs;
+    float rms = 0;
+};
+
+Mat1d stereoGuessMatrix(cv::Size size, float fov) {
+    double f = (size.width / 2.) / tan(ofDegToRad(fov) / 2);
+    return (Mat1d(3, 3) <<
+            f, 0, size.width / 2.,
+            0, f, size.height / 2.,
+            0, 0, 1);
+}
+
+Vec3d toVec3d(const Point3f& p) {
+    return Vec3d(p.x, p.y, p.z);
+}
+
+// the transform from camera space into projector space
+void stereoPose(const StereoPair& pair, Matx33d& rotation, Vec3d& translation) {
+    Rodrigues(pair.rotation, rotation);
+    const Mat1d t = pair.translation;
+    translation = Vec3d(t(0), t(1), t(2));
+}
+
+// projector pose in camera space, the form triangulatePositions expects
+void stereoProjectorPose(const StereoPair& pair, Mat& rotation, Mat& translation) {
+    Mat r;
+    Rodrigues(pair.rotation, r);
+    rotation = r.t();
+    translation = -rotation * pair.translation;
+}
+
+// every nth correspondence, at most maxPoints of them
+template <class T>
+vector<T> stereoSubsample(const vector<T>& all, int maxPoints) {
+    int stride = MAX(1, (int) all.size() / maxPoints);
+    vector<T> result;
+    for(int i = 0; i < all.size(); i += stride) {
+        result.push_back(all[i]);
+    }
+    return result;
+}
+
+void stereoTriangulate(StereoPair& pair, const StereoIntrinsics& camera, const StereoIntrinsics& projector,
+                       const vector<Point2f>& camPoints, const vector<Point2f>& proPoints,
+                       vector<Point3f>& positions, vector<float>& residuals) {
+    Mat rotation, translation;
+    stereoProjectorPose(pair, rotation, translation);
+    triangulatePositions(camPoints, camera.cameraMatrix, camera.distCoeffs,
+                         proPoints, projector.cameraMatrix, projector.distCoeffs,
+                         rotation, translation,
+                         positions, residuals);
+}
+
+// loads the proMap of every scan and splits it into one StereoPair per projector
+vector<StereoPair> loadStereoPairs(const vector<string>& scanPaths, const ofJson& settings,
+                                   float confidenceThreshold, cv::Size& cameraSize) {
+    vector<StereoPair> pairs;
+    Point2f cameraBounds(0, 0); // past the furthest camera position any proMap points to
+    for(int scan = 0; scan < scanPaths.size(); scan++) {
+        string path = scanPaths[scan];
+        ofFloatImage proConfidence, proMapFine;
+        ofShortImage proMap;
+        proConfidence.setUseTexture(false);
+        proMap.setUseTexture(false);
+        proMapFine.setUseTexture(false);
+        if(!proConfidence.load(path + "/proConfidence.exr") || !proMap.load(path + "/proMap.png")) {
+            ofLogWarning() << "skipping " << path << " without a proMap";
+            continue;
+        }
+        bool hasFine = ofFile(path + "/proMapFine.exr").exists() && proMapFine.load(path + "/proMapFine.exr");
+        if(cameraSize.area() == 0) {
+            // ProCamScan always writes the reference image, maxImage only with SAVE_DEBUG
+            ofImage referenceImage;
+            referenceImage.setUseTexture(false);
+            if(referenceImage.load(path + "/referenceImage.jpg")) {
+                cameraSize = cv::Size(referenceImage.getWidth(), referenceImage.getHeight());
+            }
+        }
+        Mat proConfidenceMat = toCv(proConfidence);
+        Mat proMapMat = toCv(proMap);
+        Mat proMapFineMat = hasFine ? toCv(proMapFine) : Mat();
+
+        for(int projector = 0; projector < settings["projectors"].size(); projector++) {
+            const ofJson& config = settings["projectors"][projector];
+            int xcode = config["xcode"], ycode = config["ycode"];
+            cv::Rect rect(xcode, ycode, config["width"], config["height"]);
+            StereoPair pair;
+            pair.scan = scan;
+            pair.projector = projector;
+            for(int y = rect.y; y < rect.br().y && y < proMapMat.rows; y++) {
+                for(int x = rect.x; x < rect.br().x && x < proMapMat.cols; x++) {
+                    float confidence = proConfidenceMat.at<float>(y, x);
+                    if(confidence > confidenceThreshold) {
+                        if(hasFine) {
+                            const Vec3f& cam = proMapFineMat.at<Vec3f>(y, x);
+                            pair.camPoints.push_back(Point2f(cam[0], cam[1]));
+                        } else {
+                            const Vec3w& cam = proMapMat.at<Vec3w>(y, x);
+                            pair.camPoints.push_back(Point2f(cam[0], cam[1]));
+                        }
+                        pair.proPoints.push_back(Point2f(x - xcode, y - ycode));
+                        pair.proPixels.push_back(cv::Point(x, y));
+                        pair.confidence.push_back(confidence);
+                        cameraBounds.x = MAX(cameraBounds.x, pair.camPoints.back().x + 1);
+                        cameraBounds.y = MAX(cameraBounds.y, pair.camPoints.back().y + 1);
+                    }
+                }
+            }
+            ofLogVerbose() << path << " projector " << projector << ": " << pair.camPoints.size() << " correspondences";
+            if(pair.camPoints.size() > 100) {
+                pairs.push_back(pair);
+            }
+        }
+    }
+    if(cameraSize.area() == 0) {
+        // no reference image in any scan, the proMaps still cover most of the camera
+        ofLogWarning() << "no referenceImage.jpg, guessing the camera size from the proMaps";
+        cameraSize = cv::Size(ceilf(cameraBounds.x), ceilf(cameraBounds.y));
+    }
+    return pairs;
+}
+
+// estimates the camera and projector intrinsics and the projector poses. starts from
+// the essential matrix of each pair with guessed intrinsics, then alternates between
+// triangulating, calibrating each projector against its points from every scan at
+// once (sharing intrinsics, one pose per scan) and recalibrating the camera, dropping
+// correspondences that reproject worse than maxResidual pixels. the camera and each
+// projector are calibrated in parallel.
+void stereoCalibrate(vector<StereoPair>& pairs, cv::Size cameraSize, const ofJson& settings,
+                     StereoIntrinsics& camera, vector<StereoIntrinsics>& projectors) {
+    const ofJson& stereo = settings["stereo"];
+    int iterations = stereo["iterations"];
+    int maxPoints = stereo["maxPoints"];
+    float maxResidual = stereo["maxResidual"];
+    int projectorCount = settings["projectors"].size();
+
+    camera.cameraMatrix = stereoGuessMatrix(cameraSize, stereo["cameraFov"]);
+    camera.distCoeffs = Mat::zeros(5, 1, CV_64F);
+    vector<cv::Size> projectorSizes(projectorCount);
+    projectors.resize(projectorCount);
+    for(int i = 0; i < projectorCount; i++) {
+        projectorSizes[i] = cv::Size(settings["projectors"][i]["width"], settings["projectors"][i]["height"]);
+        projectors[i].cameraMatrix = stereoGuessMatrix(projectorSizes[i], stereo["projectorFov"]);
+        projectors[i].distCoeffs = Mat::zeros(5, 1, CV_64F);
+    }
+
+    // the calibration only needs a subset of the correspondences
+    vector<vector<Point2f>> camSamples(pairs.size()), proSamples(pairs.size());
+    for(int i = 0; i < pairs.size(); i++) {
+        camSamples[i] = stereoSubsample(pairs[i].camPoints, maxPoints);
+        proSamples[i] = stereoSubsample(pairs[i].proPoints, maxPoints);
+    }
+
+    // relative pose up to scale from the essential matrix
+    parallelFor(pairs.size(), [&](int i) {
+        StereoPair& pair = pairs[i];
+        const StereoIntrinsics& projector = projectors[pair.projector];
+        Mat camNormalized, proNormalized, r;
+        undistortPoints(camSamples[i], camNormalized, camera.cameraMatrix, camera.distCoeffs);
+        undistortPoints(proSamples[i], proNormalized, projector.cameraMatrix, projector.distCoeffs);
+        double threshold = 1. / projector.cameraMatrix.at<double>(0, 0);
+        Mat essential = findEssentialMat(camNormalized, proNormalized, 1, Point2d(0, 0), RANSAC, .999, threshold);
+        recoverPose(essential, camNormalized, proNormalized, r, pair.translation);
+        Rodrigues(r, pair.rotation);
+    });
+
+    int flags = CV_CALIB_USE_INTRINSIC_GUESS | CV_CALIB_ZERO_TANGENT_DIST | CV_CALIB_FIX_ASPECT_RATIO | CV_CALIB_FIX_K3;
+    for(int iteration = 0; iteration < iterations; iteration++) {
+        // triangulate the samples with the current estimate and keep the good ones
+        vector<vector<Point3f>> objectPoints(pairs.size());
+        vector<vector<Point2f>> camInliers(pairs.size()), proInliers(pairs.size());
+        parallelFor(pairs.size(), [&](int i) {
+            vector<Point3f> positions;
+            vector<float> residuals;
+            stereoTriangulate(pairs[i], camera, projectors[pairs[i].projector],
+                              camSamples[i], proSamples[i], positions, residuals);
+            for(int j = 0; j < positions.size(); j++) {
+                if(residuals[j] < maxResidual && positions[j].z > 0) {
+                    objectPoints[i].push_back(positions[j]);
+                    camInliers[i].push_back(camSamples[i][j]);
+                    proInliers[i].push_back(proSamples[i][j]);
+                }
+            }
+        });
+
+        // task n < projectorCount calibrates projector n, the last one the camera
+        parallelFor(projectorCount + 1, [&](int task) {
+            vector<vector<Point3f>> taskObjectPoints;
+            vector<vector<Point2f>> taskImagePoints;
+            vector<int> taskPairs;
+            for(int i = 0; i < pairs.size(); i++) {
+                if(objectPoints[i].size() < 30) {
+                    continue;
+                }
+                if(task == projectorCount || pairs[i].projector == task) {
+                    taskObjectPoints.push_back(objectPoints[i]);
+                    taskImagePoints.push_back(task == projectorCount ? camInliers[i] : proInliers[i]);
+                    taskPairs.push_back(i);
+                }
+            }
+            if(taskPairs.empty()) {
+                return;
+            }
+            StereoIntrinsics& intrinsics = task == projectorCount ? camera : projectors[task];
+            cv::Size size = task == projectorCount ? cameraSize : projectorSizes[task];
+            vector<Mat> rvecs, tvecs;
+            intrinsics.rms = calibrateCamera(taskObjectPoints, taskImagePoints, size,
+                                             intrinsics.cameraMatrix, intrinsics.distCoeffs,
+                                             rvecs, tvecs, flags);
+            // the camera points are already in camera space, only projectors move
+            if(task < projectorCount) {
+                for(int i = 0; i < taskPairs.size(); i++) {
+                    pairs[taskPairs[i]].rotation = rvecs[i];
+                    pairs[taskPairs[i]].translation = tvecs[i];
+                }
+            }
+        });
+
+        ofLogVerbose() << "stereo iteration " << iteration << ": camera rms " << camera.rms;
+        for(int i = 0; i < projectorCount; i++) {
+            ofLogVerbose() << "\tprojector " << i << " rms " << projectors[i].rms;
+        }
+    }
+}
+
+// median of a / b wherever both maps have a depth
+float stereoDepthRatio(const Mat1f& a, const Mat1f& b) {
+    vector<float> ratios;
+    for(int i = 0; i < a.total(); i++) {
+        if(a(i) > 0 && b(i) > 0) {
+            ratios.push_back(a(i) / b(i));
+        }
+    }
+    if(ratios.empty()) {
+        return 0;
+    }
+    nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+    return ratios[ratios.size() / 2];
+}
+
+// triangulates every correspondence of every pair and moves them all into the
+// camera space of the first scan. every pair was solved at its own scale: pairs from
+// the same scan are matched by the depths they give nearby camera pixels, and scans
+// are matched through the depths of projector pixels they share with the first scan.
+void stereoTriangulateAll(vector<StereoPair>& pairs, cv::Size cameraSize, cv::Size proSize,
+                          const StereoIntrinsics& camera, const vector<StereoIntrinsics>& projectors) {
+    parallelFor(pairs.size(), [&](int i) {
+        stereoTriangulate(pairs[i], camera, projectors[pairs[i].projector],
+                          pairs[i].camPoints, pairs[i].proPoints,
+                          pairs[i].positions, pairs[i].residuals);
+    });
+
+    int scans = 0;
+    for(StereoPair& cur : pairs) {
+        scans = MAX(scans, cur.scan + 1);
+    }
+
+    // within a scan, scale every pair to the first, comparing depth on a coarse grid
+    // of camera cells so neighboring surfaces lit by different projectors overlap
+    int cellSize = 8;
+    cv::Size cells(cameraSize.width / cellSize + 1, cameraSize.height / cellSize + 1);
+    for(int scan = 0; scan < scans; scan++) {
+        Mat1f anchorDepth;
+        for(StereoPair& cur : pairs) {
+            if(cur.scan != scan) {
+                continue;
+            }
+            Mat1f depth = Mat1f::zeros(cells);
+            for(int i = 0; i < cur.positions.size(); i++) {
+                depth(cur.camPoints[i].y / cellSize, cur.camPoints[i].x / cellSize) = cur.positions[i].z;
+            }
+            if(anchorDepth.empty()) {
+                anchorDepth = depth;
+                continue;
+            }
+            float scale = stereoDepthRatio(anchorDepth, depth);
+            if(scale == 0) {
+                ofLogWarning() << "scan " << scan << " projector " << cur.projector << " doesn't overlap the other projectors in this scan, skipping";
+                cur.positions.clear();
+                continue;
+            }
+            for(Point3f& position : cur.positions) {
+                position *= scale;
+            }
+            cur.translation = cur.translation * scale;
+        }
+    }
+
+    // between scans, through the pose of a projector that the first scan also sees
+    for(int scan = 1; scan < scans; scan++) {
+        const StereoPair* reference = NULL;
+        const StereoPair* link = NULL;
+        for(const StereoPair& cur : pairs) {
+            for(const StereoPair& other : pairs) {
+                if(reference == NULL && cur.scan == scan && !cur.positions.empty() &&
+                   other.scan == 0 && !other.positions.empty() && other.projector == cur.projector) {
+                    reference = &other;
+                    link = &cur;
+                }
+            }
+        }
+        if(reference == NULL) {
+            ofLogWarning() << "scan " << scan << " shares no projector with the first scan, skipping";
+            for(StereoPair& cur : pairs) {
+                if(cur.scan == scan) {
+                    cur.positions.clear();
+                }
+            }
+            continue;
+        }
+        Matx33d referenceRotation, rotation;
+        Vec3d referenceTranslation, translation;
+        stereoPose(*reference, referenceRotation, referenceTranslation);
+        stereoPose(*link, rotation, translation);
+
+        Mat1f referenceDepth = Mat1f::zeros(proSize), depth = Mat1f::zeros(proSize);
+        for(int i = 0; i < reference->positions.size(); i++) {
+            referenceDepth(reference->proPixels[i]) = (referenceRotation * toVec3d(reference->positions[i]) + referenceTranslation)[2];
+        }
+        for(int i = 0; i < link->positions.size(); i++) {
+            depth(link->proPixels[i]) = (rotation * toVec3d(link->positions[i]) + translation)[2];
+        }
+        float scale = stereoDepthRatio(referenceDepth, depth);
+        if(scale == 0) {
+            ofLogWarning() << "scan " << scan << " shares no projector pixels with the first scan, skipping";
+        }
+
+        // into projector space, rescale, and back out into the first scan's camera space
+        Matx33d referenceInverse = referenceRotation.t();
+        for(StereoPair& cur : pairs) {
+            if(cur.scan != scan) {
+                continue;
+            }
+            if(scale == 0) {
+                cur.positions.clear();
+            }
+            for(Point3f& position : cur.positions) {
+                Vec3d p = (rotation * toVec3d(position) + translation) * scale;
+                Vec3d x = referenceInverse * (p - referenceTranslation);
+                position = Point3f(x[0], x[1], x[2]);
+            }
+        }
+    }
+}
+
+// writes the lowest residual position for every projector pixel into xyzMap, with y
+// and z flipped so up is up, normalized to a bounding box that ignores the outer
+// percent of points on each axis. returns the zero and range that were used.
+void stereoBuildXyzMap(const vector<StereoPair>& pairs, cv::Size proSize, float maxResidual,
+                       Mat& xyzMap, Mat& confidenceMap, Mat& residualMap,
+                       float& range, ofVec3f& zero) {
+    Mat3f positions = Mat3f::zeros(proSize);
+    residualMap = Mat1f(proSize, maxResidual);
+    confidenceMap = Mat1f::zeros(proSize);
+    for(const StereoPair& pair : pairs) {
+        for(int i = 0; i < pair.positions.size(); i++) {
+            const cv::Point& pixel = pair.proPixels[i];
+            float residual = pair.residuals[i];
+            if(residual < residualMap.at<float>(pixel)) {
+                const Point3f& p = pair.positions[i];
+                positions(pixel) = Vec3f(p.x, -p.y, -p.z);
+                residualMap.at<float>(pixel) = residual;
+                confidenceMap.at<float>(pixel) = pair.confidence[i];
+            }
+        }
+    }
+
+    vector<float> axes[3];
+    for(int y = 0; y < proSize.height; y++) {
+        for(int x = 0; x < proSize.width; x++) {
+            if(confidenceMap.at<float>(y, x) > 0) {
+                for(int k = 0; k < 3; k++) {
+                    axes[k].push_back(positions(y, x)[k]);
+                }
+            }
+        }
+    }
+    if(axes[0].empty()) {
+        xyzMap = Mat4f::zeros(proSize);
+        return;
+    }
+    ofVec3f low, high;
+    for(int k = 0; k < 3; k++) {
+        int n = axes[k].size();
+        nth_element(axes[k].begin(), axes[k].begin() + n / 100, axes[k].end());
+        low[k] = axes[k][n / 100];
+        nth_element(axes[k].begin(), axes[k].begin() + (n - 1 - n / 100), axes[k].end());
+        high[k] = axes[k][n - 1 - n / 100];
+    }
+    zero = low;
+    ofVec3f diagonal = high - low;
+    range = MAX(MAX(diagonal.x, diagonal.y), diagonal.z);
+
+    xyzMap = Mat4f::zeros(proSize);
+    for(int y = 0; y < proSize.height; y++) {
+        for(int x = 0; x < proSize.width; x++) {
+            float& confidence = confidenceMap.at<float>(y, x);
+            if(confidence > 0) {
+                const Vec3f& p = positions(y, x);
+                Vec3f normalized((p[0] - zero.x) / range, (p[1] - zero.y) / range, (p[2] - zero.z) / range);
+                bool inside = true;
+                for(int k = 0; k < 3; k++) {
+                    inside &= normalized[k] > -.05 && normalized[k] < 1.05;
+                }
+                if(inside) {
+                    xyzMap.at<Vec4f>(y, x) = Vec4f(normalized[0], normalized[1], normalized[2], 1);
+                } else {
+                    confidence = 0;
+                }
+            }
+        }
+    }
+}
@@ -1,4 +1,6 @@
 #include "ofxProCamToolkit.h"
+#include "Parallel.h"
+#include "opencv2/core/hal/intrin.hpp"
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/gtx/transform.hpp>
@@ -219,31 +221,139 @@ vector<vector<Point3f> > buildObjectPoints(cv::Size patternSize, float squareSiz
 	return results;
 }
 
-// need to use undistorted camera matrix when calling undistort points?
+// the ray-ray midpoint and reprojection residual, written once for both plain floats
+// and SIMD registers. the camera ray starts at the origin, the projector ray at t.
+namespace {
+	inline float splat(float x, float) { return x; }
+	inline float root(float x) { return sqrtf(x); }
+	inline float maximum(float a, float b) { return MAX(a, b); }
+#if CV_SIMD128
+	inline v_float32x4 splat(float x, v_float32x4) { return v_setall_f32(x); }
+	inline v_float32x4 root(v_float32x4 x) { return v_sqrt(x); }
+	inline v_float32x4 maximum(v_float32x4 a, v_float32x4 b) { return v_max(a, b); }
+#endif
+	
+	template <class T>
+	inline void triangulateMidpoint(T cx, T cy, T px, T py,
+									const float* r, const float* t,
+									float camFocal, float proFocal,
+									T& x, T& y, T& z, T& residual) {
+		T one = splat(1, cx);
+		T tx = splat(t[0], cx), ty = splat(t[1], cx), tz = splat(t[2], cx);
+		// projector ray direction in camera space
+		T dx = splat(r[0], cx) * px + splat(r[1], cx) * py + splat(r[2], cx);
+		T dy = splat(r[3], cx) * px + splat(r[4], cx) * py + splat(r[5], cx);
+		T dz = splat(r[6], cx) * px + splat(r[7], cx) * py + splat(r[8], cx);
+		// closest approach of (s * c) and (t + u * d), with d and e taken against +t
+		T a = cx * cx + cy * cy + one;
+		T b = cx * dx + cy * dy + dz;
+		T c = dx * dx + dy * dy + dz * dz;
+		T d = cx * tx + cy * ty + tz;
+		T e = dx * tx + dy * ty + dz * tz;
+		T den = maximum(a * c - b * b, splat(1e-12, cx));
+		T s = (c * d - b * e) / den;
+		T u = (b * d - a * e) / den;
+		T half = splat(.5, cx);
+		x = half * (s * cx + tx + u * dx);
+		y = half * (s * cy + ty + u * dy);
+		z = half * (s + tz + u * dz);
+		// reproject into both views, rotating back into projector space with r transposed
+		T ex = (x / z - cx) * splat(camFocal, cx), ey = (y / z - cy) * splat(camFocal, cx);
+		T qx = x - tx, qy = y - ty, qz = z - tz;
+		T rx = splat(r[0], cx) * qx + splat(r[3], cx) * qy + splat(r[6], cx) * qz;
+		T ry = splat(r[1], cx) * qx + splat(r[4], cx) * qy + splat(r[7], cx) * qz;
+		T rz = splat(r[2], cx) * qx + splat(r[5], cx) * qy + splat(r[8], cx) * qz;
+		T fx = (rx / rz - px) * splat(proFocal, cx), fy = (ry / rz - py) * splat(proFocal, cx);
+		residual = root(half * (ex * ex + ey * ey + fx * fx + fy * fy));
+	}
+}
+
+void triangulateRays(int n,
+		const float* camX, const float* camY,
+		const float* proX, const float* proY,
+		const float* rotation, const float* translation,
+		float camFocal, float proFocal,
+		float* x, float* y, float* z, float* residuals) {
+	int i = 0;
+#if CV_SIMD128
+	for(; i + 4 <= n; i += 4) {
+		v_float32x4 vx, vy, vz, vr;
+		triangulateMidpoint(v_load(camX + i), v_load(camY + i), v_load(proX + i), v_load(proY + i),
+							rotation, translation, camFocal, proFocal,
+							vx, vy, vz, vr);
+		v_store(x + i, vx);
+		v_store(y + i, vy);
+		v_store(z + i, vz);
+		v_store(residuals + i, vr);
+	}
+#endif
+	for(; i < n; i++) {
+		triangulateMidpoint(camX[i], camY[i], proX[i], proY[i],
+							rotation, translation, camFocal, proFocal,
+							x[i], y[i], z[i], residuals[i]);
+	}
+}
+
+void triangulatePositions(
+		const vector<Point2f>& camImagePoints, Mat camMatrix, Mat camDistCoeffs,
+		const vector<Point2f>& proImagePoints, Mat proMatrix, Mat proDistCoeffs,
+		Mat proRotation, Mat proTranslation,
+		vector<Point3f>& positions, vector<float>& residuals) {
+	int n = camImagePoints.size();
+	positions.resize(n);
+	residuals.resize(n);
+	if(n == 0) {
+		return;
+	}
+	
+	// one undistortPoints per view for the whole batch
+	Mat undistCamPoints, undistProPoints;
+	undistortPoints(camImagePoints, undistCamPoints, camMatrix, camDistCoeffs);
+	undistortPoints(proImagePoints, undistProPoints, proMatrix, proDistCoeffs);
+	
+	// interleaved points to one row per coordinate
+	Mat1f soa(4, n);
+	Mat camChannels[] = {soa.row(0), soa.row(1)};
+	Mat proChannels[] = {soa.row(2), soa.row(3)};
+	split(undistCamPoints.reshape(2, 1), camChannels);
+	split(undistProPoints.reshape(2, 1), proChannels);
+	Mat1f xyz(3, n);
+	
+	Mat1f rotation, translation;
+	proRotation.convertTo(rotation, CV_32F);
+	proTranslation.convertTo(translation, CV_32F);
+	const float* r = rotation.ptr<float>();
+	const float* t = translation.ptr<float>();
+	float camFocal = camMatrix.at<double>(0, 0);
+	float proFocal = proMatrix.at<double>(0, 0);
+	
+	int chunkSize = 4096;
+	int chunks = (n + chunkSize - 1) / chunkSize;
+	parallelFor(chunks, [&](int chunk) {
+		int begin = chunk * chunkSize;
+		int count = MIN(chunkSize, n - begin);
+		triangulateRays(count,
+						soa.ptr<float>(0) + begin, soa.ptr<float>(1) + begin,
+						soa.ptr<float>(2) + begin, soa.ptr<float>(3) + begin,
+						r, t, camFocal, proFocal,
+						xyz.ptr<float>(0) + begin, xyz.ptr<float>(1) + begin, xyz.ptr<float>(2) + begin,
+						&residuals[begin]);
+		for(int i = begin; i < begin + count; i++) {
+			positions[i] = Point3f(xyz(0, i), xyz(1, i), xyz(2, i));
+		}
+	});
+}
+
 vector<Point3f> triangulatePositions(
 		vector<Point2f>& camImagePoints, Mat camMatrix, Mat camDistCoeffs,
 		vector<Point2f>& proImagePoints, Mat proMatrix, Mat proDistCoeffs,
 		Mat proRotation, Mat proTranslation) {
 	vector<Point3f> result;
-	Mat undistCamPoints, undistProPoints;
-	undistortPoints(Mat(camImagePoints), undistCamPoints, camMatrix, camDistCoeffs);
-	undistortPoints(Mat(proImagePoints), undistProPoints, proMatrix, proDistCoeffs);
-	vector<Point2f> camPoints = (vector<Point2f>) undistCamPoints;
-	vector<Point2f> proPoints = (vector<Point2f>) undistProPoints;
-	Mat camCenter(Point3d(0, 0, 0));
-	Mat proCenter(proTranslation);
-	for(int j = 0; j < camPoints.size(); j++) {
-		Mat camHomogenous(Point3d(camPoints[j].x, camPoints[j].y, 1));
-		Mat proHomogenous(Point3d(proPoints[j].x, proPoints[j].y, 1));
-		// normally you would need to multiply by the inverse of the cam and pro matrices
-		// but that's not necessary because the coordinates have already been normalized by undistortPoints()
-		Mat camWorld(camHomogenous);
-		Mat proWorld(proRotation * proHomogenous + proTranslation);
-		Point3f closest = intersectLineLine(
-			(Point3d) camCenter, (Point3d) camWorld,
-			(Point3d) proCenter, (Point3d) proWorld);
-		result.push_back(closest);
-	}
+	vector<float> residuals;
+	triangulatePositions(camImagePoints, camMatrix, camDistCoeffs,
+						 proImagePoints, proMatrix, proDistCoeffs,
+						 proRotation, proTranslation,
+						 result, residuals);
 	return result;
 }
 
@@ -560,53 +670,83 @@ glm::vec3 getClosestPointOnMesh(const ofMesh& mesh, float x, float y, int* choic
 	return mesh.getVerticesPointer()[bestChoice];
 }
 
-int exportPlyVertices(ostream& ply, ofMesh& cloud) {
-	int total = 0;
-	int i = 0;
-	glm::vec3 zero(0, 0, 0);
-	vector<ofFloatColor>& colors = cloud.getColors();
-    auto& surface = cloud.getVertices();
-	for(int i = 0; i < surface.size(); i++) {
-		if (glm::vec3(surface[i]) != zero) {
-			ply.write(reinterpret_cast<char*>(&(surface[i].x)), sizeof(float));
-			ply.write(reinterpret_cast<char*>(&(surface[i].y)), sizeof(float));
-			ply.write(reinterpret_cast<char*>(&(surface[i].z)), sizeof(float));
-			if(colors.size() > 0) {
-				unsigned char color[3] = {
-                    (unsigned char) (255 * colors[i].r),
-                    (unsigned char) (255 * colors[i].g),
-                    (unsigned char) (255 * colors[i].b)};
-				ply.write((char*) color, sizeof(char) * 3);
-			}
-			total++;
-		}
-	}
-	return total;
-}
-
-void exportPlyCloud(string filename, ofMesh& cloud) {
+void exportPlyCloud(string filename, const ofMesh& cloud, const vector<float>& confidence) {
 	ofstream ply;
 	ply.open(ofToDataPath(filename).c_str(), ios::out | ios::binary);
-	if (ply.is_open()) {
-		// create all the vertices
-		stringstream vertices(ios::in | ios::out | ios::binary);
-		int total = exportPlyVertices(vertices, cloud);
-		
-		// write the header
-		ply << "ply" << endl;
-		ply << "format binary_little_endian 1.0" << endl;
-		ply << "element vertex " << total << endl;
-		ply << "property float x" << endl;
-		ply << "property float y" << endl;
-		ply << "property float z" << endl;
-		if (cloud.getNumColors() > 0) {
-			ply << "property uchar red" << endl;
-			ply << "property uchar green" << endl;
-			ply << "property uchar blue" << endl;
+	if(!ply.is_open()) {
+		ofLogError() << "couldn't write " << filename;
+		return;
+	}
+	const vector<glm::vec3>& vertices = cloud.getVertices();
+	const vector<glm::vec3>& normals = cloud.getNormals();
+	const vector<ofFloatColor>& colors = cloud.getColors();
+	int n = vertices.size();
+	bool hasNormals = n > 0 && normals.size() == n;
+	bool hasColors = n > 0 && colors.size() == n;
+	bool hasConfidence = n > 0 && confidence.size() == n;
+	
+	// count in a cheap first pass so the header can go first
+	glm::vec3 zero(0, 0, 0);
+	int total = 0;
+	for(int i = 0; i < n; i++) {
+		total += vertices[i] != zero;
+	}
+	
+	// write the header
+	ply << "ply" << endl;
+	ply << "format binary_little_endian 1.0" << endl;
+	ply << "element vertex " << total << endl;
+	ply << "property float x" << endl;
+	ply << "property float y" << endl;
+	ply << "property float z" << endl;
+	if(hasNormals) {
+		ply << "property float nx" << endl;
+		ply << "property float ny" << endl;
+		ply << "property float nz" << endl;
+	}
+	if(hasColors) {
+		ply << "property uchar red" << endl;
+		ply << "property uchar green" << endl;
+		ply << "property uchar blue" << endl;
+	}
+	if(hasConfidence) {
+		ply << "property float confidence" << endl;
+	}
+	ply << "end_header" << endl;
+	
+	// pack the vertices into a chunk that holds a whole number of them, and
+	// write it out every time it fills up
+	size_t stride = sizeof(glm::vec3);
+	stride += hasNormals ? sizeof(glm::vec3) : 0;
+	stride += hasColors ? 3 : 0;
+	stride += hasConfidence ? sizeof(float) : 0;
+	vector<char> chunk(MAX(1, (1 << 20) / stride) * stride);
+	char* begin = chunk.data();
+	char* end = begin + chunk.size();
+	char* cur = begin;
+	for(int i = 0; i < n; i++) {
+		if(vertices[i] == zero) {
+			continue;
+		}
+		memcpy(cur, &vertices[i], sizeof(glm::vec3));
+		cur += sizeof(glm::vec3);
+		if(hasNormals) {
+			memcpy(cur, &normals[i], sizeof(glm::vec3));
+			cur += sizeof(glm::vec3);
+		}
+		if(hasColors) {
+			*cur++ = (unsigned char) (255 * colors[i].r);
+			*cur++ = (unsigned char) (255 * colors[i].g);
+			*cur++ = (unsigned char) (255 * colors[i].b);
+		}
+		if(hasConfidence) {
+			memcpy(cur, &confidence[i], sizeof(float));
+			cur += sizeof(float);
+		}
+		if(cur == end) {
+			ply.write(begin, cur - begin);
+			cur = begin;
 		}
-		ply << "end_header" << endl;
-		
-		// write all the vertices
-		ply << vertices.rdbuf();
 	}
+	ply.write(begin, cur - begin);
 }
@@ -32,6 +32,22 @@ vector<cv::Point3f> triangulatePositions(
 	vector<cv::Point2f>& camImagePoints, cv::Mat camMatrix, cv::Mat camDistCoeffs,
 	vector<cv::Point2f>& proImagePoints, cv::Mat proMatrix, cv::Mat proDistCoeffs,
 																		 cv::Mat proRotation, cv::Mat proTranslation);
+// same as above, plus the rms reprojection error in pixels of each position in
+// both views, for filtering bad correspondences. multithreaded and SIMD.
+void triangulatePositions(
+	const vector<cv::Point2f>& camImagePoints, cv::Mat camMatrix, cv::Mat camDistCoeffs,
+	const vector<cv::Point2f>& proImagePoints, cv::Mat proMatrix, cv::Mat proDistCoeffs,
+	cv::Mat proRotation, cv::Mat proTranslation,
+	vector<cv::Point3f>& positions, vector<float>& residuals);
+// the allocation free kernel behind triangulatePositions, on undistorted normalized
+// coordinates in separate arrays. rotation is a row major 3x3 and translation the
+// projector position, both in camera space.
+void triangulateRays(int n,
+	const float* camX, const float* camY,
+	const float* proX, const float* proY,
+	const float* rotation, const float* translation,
+	float camFocal, float proFocal,
+	float* x, float* y, float* z, float* residuals);
 void drawCamera(cv::Mat camMatrix, cv::Size size, float scale, ofImage& img);
 void drawLabeledAxes(float size);
 void drawImagePoints(cv::Mat camMatrix, vector<cv::Point2f>& imagePoints, float scale);
@@ -57,4 +73,7 @@ void updateFrustrum(ofCamera & cam, Plane pl[6]);
 cv::Point2f getClosestPoint(const vector<cv::Point2f>& vertices, float x, float y, int* choice = NULL, float* distance = NULL);
 glm::vec3 getClosestPointOnMesh(const ofMesh& mesh, float x, float y, int* choice = NULL, float* distance = NULL);
 
-void exportPlyCloud(string filename, ofMesh& cloud);
\ No newline at end of file
+// streams the mesh to a binary ply, skipping vertices at the origin. includes normals
+// and colors when the mesh has one per vertex, and a float confidence property when
+// confidence has one value per vertex.
+void exportPlyCloud(string filename, const ofMesh& cloud, const vector<float>& confidence = vector<float>());
\ No newline at end of file